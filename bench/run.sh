@@ -0,0 +1,61 @@
+#!/bin/bash
+#Run the visualize pass over synthetic modules of growing size, and
+#print one CSV line per module: its shape, wall time, peak memory and
+#what was written. The counts come from -visualize-report.
+#
+#  VISUALIZE_SO=path/to/visualize.so GEN=path/to/visualize-gen bench/run.sh [configs]
+#
+#Each config is functions:blocks:insts:loop-depth:globals. Without any,
+#the default ones below are run, which grow one dimension at a time.
+#Set OPT_FLAGS=-enable-new-pm=0 on LLVM versions where the legacy pass
+#manager isn't the default, and PROFILE to one of skeleton, standard
+#or full (the default).
+
+OPT=${OPT:-opt}
+GEN=${GEN:-visualize-gen}
+PROFILE=${PROFILE:-full}
+if [ -z "$VISUALIZE_SO" ]; then
+  echo "Set VISUALIZE_SO to the path of visualize.so" >&2
+  exit 1
+fi
+
+CONFIGS="$@"
+if [ -z "$CONFIGS" ]; then
+  CONFIGS="10:10:10:1:4 100:10:10:1:4 1000:10:10:1:4
+	   10:100:10:1:4 10:1000:10:1:4
+	   10:10:100:1:4 10:10:1000:1:4
+	   10:10:10:3:4 10:10:10:6:4
+	   10:10:10:1:64 10:10:10:1:1024"
+fi
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+#A number from the report, eg. "peak_rss_kb"
+report_value() {
+  sed -n "s/^[[:space:]]*\"$1\": \([0-9.]*\),*$/\1/p" "$WORK/report.json"
+}
+
+echo "functions,blocks,insts,loop_depth,globals,wall_s,peak_rss_kb,views,nodes,edges,files_written,bytes_written"
+for config in $CONFIGS; do
+  IFS=: read functions blocks insts depth globals <<< "$config"
+  "$GEN" -functions=$functions -blocks=$blocks -insts=$insts \
+	 -loop-depth=$depth -globals=$globals -o "$WORK/module.ll" || exit 1
+
+  #Every run starts from an empty data folder, so no diffs are made
+  rm -rf "$WORK/data" "$WORK/count.txt" "$WORK/report.json"
+  mkdir -p "$WORK/data"
+
+  start=$(date +%s.%N)
+  "$OPT" $OPT_FLAGS -load "$VISUALIZE_SO" -visualize \
+	 -visualize-profile=$PROFILE -visualize-sync=false -visualize-verbose=false \
+	 -visualize-data="$WORK/data/" -visualize-epoch-file="$WORK/count.txt" \
+	 -visualize-report="$WORK/report.json" \
+	 -disable-output "$WORK/module.ll" || exit 1
+  end=$(date +%s.%N)
+
+  wall=$(echo "$end - $start" | bc)
+  echo "$functions,$blocks,$insts,$depth,$globals,$wall,$(report_value peak_rss_kb)," \
+       "$(report_value views),$(report_value nodes),$(report_value edges)," \
+       "$(report_value files_written),$(report_value bytes_written)" | tr -d ' '
+done
@@ -0,0 +1,124 @@
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+
+//////////////////////////////////////////////////////////////////
+// Benchmark generator - Writes a synthetic module of a chosen	//
+// size, for bench/run.sh to run the visualize pass over	//
+//////////////////////////////////////////////////////////////////
+
+static cl::opt<unsigned> numFunctions("functions", cl::init(10),
+  cl::desc("Functions in the module"));
+static cl::opt<unsigned> numBlocks("blocks", cl::init(10),
+  cl::desc("Blocks in the innermost loop of each function"));
+static cl::opt<unsigned> numInsts("insts", cl::init(10),
+  cl::desc("Steps in each of those blocks (a load and add, a store or a mul)"));
+static cl::opt<unsigned> loopDepth("loop-depth", cl::init(1),
+  cl::desc("How deep the loops of each function are nested"));
+static cl::opt<unsigned> numGlobals("globals", cl::init(4),
+  cl::desc("Globals used by every function"));
+static cl::opt<string> outputFile("o", cl::init("-"),
+  cl::desc("Where to write the module, as textual IR"));
+
+//Fill the block B is in, and numBlocks - 1 more after it, with
+//numInsts steps each. Every block loads from the globals, does
+//some arithmetic on 'acc' and stores it back.
+static Value *emit_body(IRBuilder<> &B, Function *F, Value *acc,
+			const vector<GlobalVariable*> &globals) {
+  for (unsigned b = 0; b < numBlocks; b++) {
+    if (b > 0) {
+      BasicBlock *next = BasicBlock::Create(F->getContext(),"",F);
+      B.CreateBr(next);
+      B.SetInsertPoint(next);
+    }
+
+    for (unsigned i = 0; i < numInsts; i++) {
+      GlobalVariable *g = globals.empty() ? nullptr : globals[(b + i) % globals.size()];
+      if (g && i % 3 == 0)
+	acc = B.CreateAdd(acc,B.CreateLoad(B.getInt32Ty(),g));
+      else if (g && i % 3 == 1)
+	B.CreateStore(acc,g);
+      else
+	acc = B.CreateMul(acc,B.getInt32(i + 3));
+    }
+  }
+  return acc;
+}
+
+//Emit 'depth' nested loops around the body, from the block B is in.
+//Leaves B in the block after the outermost loop.
+static Value *emit_loops(IRBuilder<> &B, Function *F, unsigned depth, Value *acc,
+			 const vector<GlobalVariable*> &globals) {
+  if (depth == 0)
+    return emit_body(B,F,acc,globals);
+
+  LLVMContext &C = F->getContext();
+  BasicBlock *preheader = B.GetInsertBlock();
+  BasicBlock *header = BasicBlock::Create(C,"",F);
+  BasicBlock *body = BasicBlock::Create(C,"",F);
+  BasicBlock *exit = BasicBlock::Create(C,"",F);
+  B.CreateBr(header);
+
+  B.SetInsertPoint(header);
+  PHINode *iv = B.CreatePHI(B.getInt32Ty(),2);
+  PHINode *sum = B.CreatePHI(B.getInt32Ty(),2);
+  iv->addIncoming(B.getInt32(0),preheader);
+  sum->addIncoming(acc,preheader);
+  B.CreateCondBr(B.CreateICmpSLT(iv,B.getInt32(4)),body,exit);
+
+  B.SetInsertPoint(body);
+  Value *inner = emit_loops(B,F,depth - 1,sum,globals);
+  BasicBlock *latch = B.GetInsertBlock();
+  iv->addIncoming(B.CreateAdd(iv,B.getInt32(1)),latch);
+  sum->addIncoming(inner,latch);
+  B.CreateBr(header);
+
+  B.SetInsertPoint(exit);
+  return sum;
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc,argv,"Synthetic module generator for the visualize pass\n");
+
+  LLVMContext C;
+  Module M("bench",C);
+  Type *i32 = Type::getInt32Ty(C);
+
+  vector<GlobalVariable*> globals;
+  for (unsigned g = 0; g < numGlobals; g++)
+    globals.push_back(new GlobalVariable(M,i32,false,GlobalValue::ExternalLinkage,
+					 ConstantInt::get(i32,g),"g" + to_string(g)));
+
+  //Each function calls the one before it, so the module view has edges
+  FunctionType *FT = FunctionType::get(i32,{i32},false);
+  Function *last = nullptr;
+  for (unsigned f = 0; f < numFunctions; f++) {
+    Function *F = Function::Create(FT,Function::ExternalLinkage,"f" + to_string(f),&M);
+    IRBuilder<> B(BasicBlock::Create(C,"",F));
+    Value *acc = emit_loops(B,F,loopDepth,&*F->arg_begin(),globals);
+    if (last)
+      acc = B.CreateAdd(acc,B.CreateCall(last,{acc}));
+    B.CreateRet(acc);
+    last = F;
+  }
+
+  if (verifyModule(M,&errs()))
+    return 1;
+
+  error_code EC;
+  raw_fd_ostream OS(outputFile,EC,sys::fs::F_None);
+  if (EC) {
+    errs() << "Unable to write " << outputFile << ": " << EC.message() << "\n";
+    return 1;
+  }
+  M.print(OS,nullptr);
+  return 0;
+}
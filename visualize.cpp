@@ -25,6 +25,8 @@ static RegisterPass<visualize> X("visualize", "Pass to print a nice d3 web visua
 unordered_map<BasicBlock*,string> loopIDs;
 unordered_map<BasicBlock*,int> loopNum;
 unordered_map<Value*,string> nameMap;
+sys::SmartRWMutex<true> nameLock;
+call_graph callGraph;
 int current_epoch;
 
 
@@ -53,7 +55,7 @@ void set_constraints(Function *fun_source, node *n) {
 
     //Create a temporary node for a target, must have correct name for
     //target -- but that is all. 
-    node *node_target = new node();
+    node *node_target = create_node(*n->arena);
     node_target->name = get_name(fun_target);
 
     //Set the edge width
@@ -83,6 +85,7 @@ vector<string> get_dependencies(Function *f, node *n) {
 //Text to go into the 'IR' tab
 string get_ir(Function *f){
   if (!ENABLE_IR) return "Disabled";
+  stage_timer timer(IR_STAGE);
 
   //Get the contents of this function
   string IR = print(f);
@@ -95,6 +98,7 @@ string get_ir(Function *f){
 //Text for the debug tab
 string get_debug(Function *f) {
   if (!ENABLE_DEBUG) return "Disabled";
+  stage_timer timer(DEBUG_STAGE);
   
   string debug_header = "Filename: " + get_file(f) + "\nDirectory: " + get_dir(f);
   string debug_content ="";
@@ -108,55 +112,73 @@ string get_debug(Function *f) {
   return debug_header + "\n" + debug_content;
 }
 
+//Finish a view's summary line with how much changed since the last
+//epoch, and how much of it the object store had already
+void print_data_stats(raw_ostream &log, const data_stats &stats) {
+  if (ENABLE_DIFF && current_epoch > 0)
+    log << "\t Changed: " << stats.changed
+	<< "\t New: " << stats.added
+	<< "\t Diff: " << format("%.1f", stats.ms) << " ms";
+  if (STORE_DATA_OBJECTS)
+    log << "\t Stored: " << stats.stored << " (" << stats.stored_bytes << " bytes)"
+	<< "\t Reused: " << stats.reused;
+  log << "\n";
+}
 
-//Create the full view. This assumes that the folders have already
-//been created, and their names are in the 'folders' vector.
-void create_control_flow_view(Module &m, vector<string> folders)
+//Build the nodes of the module view, without writing anything
+void build_control_flow_view(Module &m, vector<string> folders, view &v, raw_ostream &log)
 {
-  vector<node*> nodes;   
-  string title = get_name(&m);
-  if (VERBOSE)
-    outs() << "Creating control flow view for module: " << title;
-
+  stage_timer timer(GRAPH_STAGE);
+  view_arena &arena = v.arena;
+  vector<node*> &nodes = v.nodes;
+  v.title = get_name(&m);
  
   //Create the objects. Each function is a node.
   for (Function &f : m) {
     if (!SHOW_FUNCTION_DECLARATIONS && f.isDeclaration()) continue;
 
     //Create a node for this function with default settings
-    node *n = new node(&f);
+    node *n = create_node(arena,&f);
     n->name = get_name(&f); 
     n->type = get_type(&f);
     n->group = get_group(&f);
     n->depends = get_dependencies(&f,n);        
     n->metadata = get_ir(&f);
     n->src = get_debug(&f);
-    n->json = create_object(n);
     nodes.push_back(n);    
 
     //Set the constraints for this node
     set_constraints(&f,n);
 
-    if (VERBOSE) outs() << ".";
+    if (VERBOSE) log << ".";
   }
-  
-  //Create objects.json 
+}
+
+//Create the full view. This assumes that the folders have already
+//been created, and their names are in the 'folders' vector.
+void create_control_flow_view(Module &m, vector<string> folders)
+{
+  view v;
+  string title = get_name(&m);
+  if (VERBOSE)
+    outs() << "Creating control flow view for module: " << title;
+
+  begin_view_report("Module_Control_" + title);
+  build_control_flow_view(m,folders,v,outs());
+
+  //Create graph.json, config.json and the *.mkdn files
   string folder = dataFolder + "Module_Control_" + title + "/";
-  create_objects_file(folder,nodes);
-  
-  //Create config.json
-  vector<int> config = get_config(nodes.size());
-  create_config_file(config,folder,title,nodes);
-  
-  //Create the *.mkdn files for each object
-  create_data_files(folder,nodes);
+  data_stats stats = write_view(folder,v);
+  end_view_report(v);
 
   //Print some nice output
-  if (VERBOSE)
-    outs() << "\t Total Nodes: " << nodes.size() << "\n";
+  if (VERBOSE) {
+    outs() << "\t Total Nodes: " << v.nodes.size();
+    print_data_stats(outs(),stats);
+  }
 
-  //Sync the data folder to the web folder
-  if (DO_SYNC) system(syncCommand.c_str());        
+  //Publish the view to the web folder
+  if (publishing()) publish_view(folder);
 }
 
 
@@ -199,15 +221,16 @@ vector<string> get_dependencies(BasicBlock *b, node *n) {
 }
 
 //Text for the IR tab
-string get_ir(BasicBlock*b) {
+string get_ir(BasicBlock*b, ModuleSlotTracker *MST) {
   if (!ENABLE_IR) return "Disabled";  
+  stage_timer timer(IR_STAGE);
 
   //First, get the file/line/col debug information for this block
   string debug = "";
   vector<int> lines, cols;
   for (Instruction &i : *b) {
     //    if (MDNode *N = i.getMetadata("dbg")) {  
-    if (i.getMetadata("dbg")) {  
+    if (i.getMetadata(LLVMContext::MD_dbg)) {  
       DebugLoc loc = i.getDebugLoc();
       int line = loc.getLine();
       int col = loc.getCol();
@@ -222,7 +245,7 @@ string get_ir(BasicBlock*b) {
   debug = "File: " + get_file(b->getParent()) + ", Lines: " + format_as_range(lines) + " " + "Cols: " + format_as_range(cols);
 
   //Get the contents of this block
-  string code = debug + print(b);
+  string code = debug + print(b,MST);
   
   //Build the full metadata page with navigation to related functions,
   //and a list of all available views
@@ -230,22 +253,29 @@ string get_ir(BasicBlock*b) {
 }
 
 //Text for the debug tab
-string get_debug(BasicBlock *b) {
+string get_debug(BasicBlock *b, ModuleSlotTracker *MST) {
   if (!ENABLE_DEBUG) return "Disabled";  
+  stage_timer timer(DEBUG_STAGE);
   string debug_header = "Filename: " + get_file(b->getParent()) + "\nDirectory: " + get_dir(b->getParent());
-  string debug_content = get_blk_metadata(b);
+  string debug_content = get_blk_metadata(b,MST);
 
   return debug_header + "\n\n" + debug_content;
 }
 
-void create_control_flow_view(Function &f, vector<string> folders, LoopInfo *LI) {
-  vector<node*> nodes;
-  string title = get_name(&f);
-  if (VERBOSE)
-    outs() << "Creating control flow view for function: " << title;
+//Build the nodes of a function's control flow view, without writing
+//anything
+void build_control_flow_view(Function &f, vector<string> folders, LoopInfo *LI, view &v, raw_ostream &log) {
+  stage_timer timer(GRAPH_STAGE);
+  view_arena &arena = v.arena;
+  vector<node*> &nodes = v.nodes;
+  v.title = get_name(&f);
+
+  //Every print in this view shares one slot tracker
+  ModuleSlotTracker MST(f.getParent(),false);
+  name_function_values(f);
 
   //Create a independant function node (a helper)
-  node *n = create_function_node(&f,folders,true);
+  node *n = create_function_node(&f,folders,true,arena);
   nodes.push_back(n);
 
   //Create independant loop nodes, without duplicates
@@ -261,47 +291,65 @@ void create_control_flow_view(Function &f, vector<string> folders, LoopInfo *LI)
     WL.push_back(loop);
 
     //Create the loop node
-    node *n = create_loop_node(loop,folders,true);
+    node *n = create_loop_node(loop,folders,true,arena,&MST);
     nodes.push_back(n);
   }
   
   //Create the basicblock nodes
   for (BasicBlock &b : f) {
-    node *n = new node(&b);
+    node *n = create_node(arena,&b);
     n->name = get_name(&b);
     n->type = get_type(&b);
     n->group = get_group(&b);
     n->depends = get_dependencies(&b,n); 
-    n->metadata = get_ir(&b);
-    n->src = get_debug(&b);
-    n->json = create_object(n);
+    n->metadata = get_ir(&b,&MST);
+    n->src = get_debug(&b,&MST);
     nodes.push_back(n);
     
     set_constraints(&b,n);
 
-    if (VERBOSE) outs() << ".";
+    if (VERBOSE) log << ".";
   }
-    
-  //Create objects.json
+}
+
+//'fingerprint' is the function's, from get_fingerprint (if
+//INCREMENTAL_EPOCHS), which both of its views share
+void create_control_flow_view(Function &f, vector<string> folders, LoopInfo *LI,
+			      string fingerprint, raw_ostream &log) {
+  view v;
+  string title = get_name(&f);
   string folder = dataFolder + "Function_Control_" + title + "/";
-  create_objects_file(folder,nodes);
 
-  //Create config.json
-  vector<int> config = get_config(nodes.size());
-  create_config_file(config,folder,title,nodes);
+  //Point at the last epoch's view if nothing in this function changed
+  if (INCREMENTAL_EPOCHS && reuse_view(folder,fingerprint)) {
+    if (VERBOSE)
+      log << "Reusing control flow view for function: " << title << "\n";
+    if (publishing()) publish_view(folder);
+    return;
+  }
+
+  if (VERBOSE)
+    log << "Creating control flow view for function: " << title;
+
+  begin_view_report("Function_Control_" + title);
+  build_control_flow_view(f,folders,LI,v,log);
 
-  //Create the *.mkdn files for each object
-  create_data_files(folder,nodes);
+  //Create graph.json, config.json and the *.mkdn files
+  data_stats stats = write_view(folder,v);
+  end_view_report(v);
 
   //Print some nice output
   // int paddingLength = 15;
   // if (paddingLength - title.size() > 0)
   //   title.insert(title.end(),paddingLength - title.size(), ' ');
-  if (VERBOSE)
-    outs() << "\t Total Nodes: " << nodes.size() << "\n";
+  if (VERBOSE) {
+    log << "\t Total Nodes: " << v.nodes.size();
+    print_data_stats(log,stats);
+  }
+  if (INCREMENTAL_EPOCHS) write_fingerprint(folder,fingerprint);
 
-  //Sync the data folder to the web folder
-  if (DO_SYNC) system(syncCommand.c_str());          
+  //Publish the view to the web folder
+  if (publishing()) publish_view(folder);
 }
 
 
@@ -316,25 +364,27 @@ void create_control_flow_view(Function &f, vector<string> folders, LoopInfo *LI)
   nodes for the loops, and function have also been added.
 **************************************************************************/
 
-static float step = 0;
-void set_constraints(Value *v, node *n, vector<Value*> &Inputs, vector<Value*> &Outputs) {  
-  if (find(Inputs.begin(),Inputs.end(),v) != Inputs.end()) {
+//'step' spreads the inputs out along the top, it belongs to the view
+//being built
+void set_constraints(Value *v, node *n, SetVector<Value*> &Inputs, SetVector<Value*> &Outputs, float &step) {  
+  if (Inputs.count(v)) {
     set_Y_position(n,0,5); //Put input nodes at the top
     set_X_position(n,step,1); //Spread them out over the X dimension
     step = step + 1.0/Inputs.size();
   }
 
-  if (find(Outputs.begin(),Outputs.end(),v) != Outputs.end())
+  if (Outputs.count(v))
     set_Y_position(n,1,5); //Put the output nodes a the bottom
 }
 
 //Text for the IR tab
-string get_ir(Value *v) {
+string get_ir(Value *v, ModuleSlotTracker *MST) {
   if (!ENABLE_IR) return "Disabled";
+  stage_timer timer(IR_STAGE);
   //Get the file/line/col debug information if this is an instruciton
   string debug = "";
   if (Instruction *i = dyn_cast<Instruction>(v)) {
-    if (i->getMetadata("dbg")) {
+    if (i->getMetadata(LLVMContext::MD_dbg)) {
       DebugLoc loc = i->getDebugLoc();
       string line = to_string(loc.getLine());
       string col = to_string(loc.getCol());      
@@ -343,7 +393,7 @@ string get_ir(Value *v) {
   }
 
   //Get the contents of this value
-  string code = debug + "\n" + print(v);
+  string code = debug + "\n" + print(v,MST);
   
   //Add the instruction operands, and parent block in different code blocks
   string other = "\n" + syntax_end + "\n"; //End the last code block
@@ -353,12 +403,12 @@ string get_ir(Value *v) {
     for (Use &op : i->operands()) {
       int opNum = op.getOperandNo();
       string opPrefix = "Operand # " + to_string(opNum) + " (" + get_val_addr(op) + ") <br />";
-      string opData = print(op);
+      string opData = print(op,MST);
       other += opPrefix + syntax_beg + opData + syntax_end;
     }
     //code = change_instructions_to_links(parentFun,code);    
 
-    string parentBlk_data = print(i->getParent());
+    string parentBlk_data = print(i->getParent(),MST);
     other += "Parent Block : <br />" + syntax_beg + parentBlk_data + syntax_end;
   } 
 
@@ -367,7 +417,8 @@ string get_ir(Value *v) {
 
 //Create an instruction node. These depend on which other instructions
 //or values this instruction uses.
-vector<string> get_dependencies(Instruction *i, vector<Value*> &Inputs) {  
+vector<string> get_dependencies(Instruction *i, const hidden_instructions &hidden,
+				SetVector<Value*> &Inputs) {  
   vector<string> depends;
 
   //An instruction uses its operands, and thus depends on them
@@ -375,7 +426,7 @@ vector<string> get_dependencies(Instruction *i, vector<Value*> &Inputs) {
 
     //If the operand is another instruction, we depend on that instruction
     if (Instruction* op  = dyn_cast<Instruction>(u)) {
-      if (!hide(*op)) {
+      if (!hide(*op,hidden)) {
 	depends.push_back(get_name(u));
       }
     }
@@ -389,20 +440,31 @@ vector<string> get_dependencies(Instruction *i, vector<Value*> &Inputs) {
       continue;
     
     //If we depend on an input (a function argument) add it.
-    else if (find(Inputs.begin(),Inputs.end(),u) != Inputs.end()) 
+    else if (Inputs.count(u)) 
       depends.push_back(get_name(u));
   }
   return depends;
 }
   
-void create_data_flow_view(Function &f, vector<string> folders, LoopInfo *LI) {
-    vector<node*> nodes;
-    string title = get_name(&f);
-    if (VERBOSE)
-      outs() << "Creating dataflow view for function: " << title;
-    
+//Build the nodes of a function's data flow view, without writing
+//anything
+void build_data_flow_view(Function &f, vector<string> folders, LoopInfo *LI, view &v, raw_ostream &log) {
+    stage_timer timer(GRAPH_STAGE);
+    view_arena &arena = v.arena;
+    vector<node*> &nodes = v.nodes;
+    float step = 0;
+    v.title = get_name(&f);
+    v.kind = DATA_FLOW_VIEW;
+
+    //Every print in this view shares one slot tracker
+    ModuleSlotTracker MST(f.getParent(),false);
+    name_function_values(f);
+
+    //Decide once which instructions are left out of the view
+    hidden_instructions hidden(f);
+
     //Create an function helper node
-    node *n = create_function_node(&f,folders,true);    
+    node *n = create_function_node(&f,folders,true,arena);    
     nodes.push_back(n);
 
     //Create loop helper nodes
@@ -414,56 +476,55 @@ void create_data_flow_view(Function &f, vector<string> folders, LoopInfo *LI) {
 	if (find(WL.begin(),WL.end(),loop) != WL.end()) continue;
 	WL.push_back(loop);
 
-	node *n = create_loop_node(loop,folders,false);
+	node *n = create_loop_node(loop,folders,false,arena,&MST,&hidden);
 	nodes.push_back(n);
       }
     }
       
     //Create the data value input nodes (ones with data defined
     //outside the function)
-    vector<Value*> Inputs, Outputs;
+    SetVector<Value*> Inputs, Outputs;
     vector<string> empty_set;
-    findInputOutputs(&f, Inputs, Outputs);
+    findInputOutputs(&f, hidden, Inputs, Outputs);
     for (Value * v : Inputs) {
-      node *n = new node(v);
+      node *n = create_node(arena,v);
       n->name = get_name(v);
       n->type = get_type(v);
       n->group = get_group(v);
       n->depends = empty_set;
-      n->metadata = get_ir(v);
-      n->json = create_object(n);
+      n->metadata = get_ir(v,&MST);
       nodes.push_back(n);
       
-      set_constraints(v,n,Inputs,Outputs);
+      set_constraints(v,n,Inputs,Outputs,step);
 
-      if (VERBOSE) outs() << ".";
+      if (VERBOSE) log << ".";
     }
-    step = 0; //Local global used in set_constraints
+    step = 0; //Used in set_constraints
 
     //Create the data value output nodes (ones with no children)
     for (Value * v : Outputs) {
-      node *n = new node(v);
+      node *n = create_node(arena,v);
       n->name = get_name(v);
       n->type = get_type(v);
       n->group = get_group(v);
       if (Instruction *i = dyn_cast<Instruction>(v)) {
-	if (hide(*i)) continue;
-	n->depends = get_dependencies(i,Inputs);
+	if (hide(*i,hidden)) continue;
+	n->depends = get_dependencies(i,hidden,Inputs);
       } else {
 	n->depends = empty_set;
       }
-      n->metadata = get_ir(v);
-      n->json = create_object(n);
+      n->metadata = get_ir(v,&MST);
       nodes.push_back(n);
       
-      set_constraints(v,n,Inputs,Outputs);
+      set_constraints(v,n,Inputs,Outputs,step);
       
-      if (VERBOSE) outs() << ".";
+      if (VERBOSE) log << ".";
     }
-    step = 0; //Local global used in set_constraints    
+    step = 0; //Used in set_constraints    
 
     //Add all nodes now (nearly everything in the function, whether
     //it is connected or not).
+    unsigned number = 0;
     for (BasicBlock &b : f) {
       for (Instruction &i : b) {
 
@@ -471,46 +532,101 @@ void create_data_flow_view(Function &f, vector<string> folders, LoopInfo *LI) {
 	//about, such as unconditional branches, unreachable
 	//instructions, metadata nodes, or calls to common functions
 	//such as 'printf'.
-	if (hide(i)) continue;
+	if (hidden[number++]) continue;
 
 	//Create our node
-	node *n = new node(&i);
+	node *n = create_node(arena,&i);
 	n->name = get_name(&i);
 	n->type = get_type(&i);
 	n->group = get_group(&i);
-	n->depends = get_dependencies(&i,Inputs);
-	n->metadata = get_ir(&i);
-	n->json = create_object(n);      		
+	n->depends = get_dependencies(&i,hidden,Inputs);
+	n->metadata = get_ir(&i,&MST);
 	nodes.push_back(n);
 
-	if (VERBOSE) outs() << ".";
+	if (VERBOSE) log << ".";
       }
     }
 
-    //Create objects.json
+    if (VERBOSE)
+      log << "\t Inputs: " << Inputs.size()
+	  << "\t Outputs: " << Outputs.size();
+}
+
+void create_data_flow_view(Function &f, vector<string> folders, LoopInfo *LI,
+			   string fingerprint, raw_ostream &log) {
+    view v;
+    string title = get_name(&f);
     string folder = dataFolder + "Function_Data_" + title + "/";
-    create_objects_file(folder,nodes);
 
-    //Create config.json
-    vector<int> config = get_config(nodes.size());
-    create_config_file(config,folder,title,nodes);
+    //Point at the last epoch's view if nothing in this function changed
+    if (INCREMENTAL_EPOCHS && reuse_view(folder,fingerprint)) {
+      if (VERBOSE)
+	log << "Reusing dataflow view for function: " << title << "\n";
+      if (publishing()) publish_view(folder);
+      return;
+    }
+
+    if (VERBOSE)
+      log << "Creating dataflow view for function: " << title;
 
-    //Create the *.mkdn files for each object
-    create_data_files(folder,nodes);
+    begin_view_report("Function_Data_" + title);
+    build_data_flow_view(f,folders,LI,v,log);
+
+    //Create graph.json, config.json and the *.mkdn files
+    data_stats stats = write_view(folder,v);
+    end_view_report(v);
 
     //Print some nice output
     if (VERBOSE) {
-      outs() << "\t Inputs: " << Inputs.size()
-	     << "\t Outputs: " << Outputs.size()
-	     << "\t Total Nodes: " << nodes.size() << "\n";
+      log << "\t Total Nodes: " << v.nodes.size();
+      print_data_stats(log,stats);
     }
+    if (INCREMENTAL_EPOCHS) write_fingerprint(folder,fingerprint);
 
-    //Sync the data folder to the web folder
-    if (DO_SYNC) system(syncCommand.c_str());
+    //Publish the view to the web folder
+    if (publishing()) publish_view(folder);
 }
 
-//Finds the current epoch
-string get_epoch(string filename) {
+//Create the control and data flow views of every function on a pool
+//of threads. Each view only touches its own nodes and folder, so the
+//files written are the same as building them one after another.
+void create_function_views_in_parallel(Module &m, vector<string> folders) {
+  ThreadPool pool(NUM_THREADS);
+  mutex logLock;
+
+  for (Function &f : m) {
+    if (f.isDeclaration()) continue;
+    if (onlyDoFuns != "all" &&
+	onlyDoFuns.find(get_name(&f)) == string::npos)
+      continue;
+
+    Function *fun = &f;
+    pool.async([fun,&folders,&logLock]() {
+	//LoopInfo from the pass manager can't be shared between
+	//threads, so each function gets its own
+	DominatorTree DT(*fun);
+	LoopInfo LI(DT);
+
+	//Keep this function's output together
+	string log;
+	raw_string_ostream log_stream(log);
+
+	string fingerprint = INCREMENTAL_EPOCHS ? get_fingerprint(*fun,&LI) : "";
+	if (CREATE_CF_FUNCTION_VIEWS)
+	  create_control_flow_view(*fun,folders,&LI,fingerprint,log_stream);
+	if (CREATE_DF_FUNCTION_VIEWS)
+	  create_data_flow_view(*fun,folders,&LI,fingerprint,log_stream);
+
+	lock_guard<mutex> guard(logLock);
+	outs() << log_stream.str();
+      });
+  }
+  pool.wait();
+}
+
+//Finds the current epoch. 'save' writes it back as the newest one,
+//the server doesn't so it can diff against what was last written
+string get_epoch(string filename, bool save) {
   string currentEpoch = "0";
 
   fstream File;
@@ -525,6 +641,7 @@ string get_epoch(string filename) {
   }
   
   //Write current epoch number back to file
+  if (!save) return currentEpoch;
   File.open (filename, std::fstream::out | std::fstream::trunc);  
   if (File.is_open()) {
     File << setfill('0') << setw(5)<< currentEpoch; //Pad with zeros
@@ -534,11 +651,23 @@ string get_epoch(string filename) {
   return currentEpoch;
 }
 
+//Create the folder of a view in this epoch's data folder. Like mkdir,
+//it is readable by all less the umask
+static void create_view_folder(string name) {
+  if (error_code EC = sys::fs::create_directories(dataFolder + name,true,sys::fs::all_all))
+    errs() << "Unable to create " << dataFolder << name << ": " << EC.message() << "\n";
+}
+
 bool visualize::runOnModule(Module &m)
 {
+  apply_options();
+  begin_pass_report();
 
-  string epochStr = get_epoch(epochFile);
-  dataFolder = "data/epoch" + epochStr + "/";
+  //When publishing, the count is only written once the epoch is in
+  //the web folder
+  string epochStr = get_epoch(epochFile,!SERVE_VIEWS && !publishing());
+  dataFolder = dataRoot + "epoch" + epochStr + "/";
+  if (publishing() && !SERVE_VIEWS) begin_publish();
 
   if (VERBOSE) {
     char full_path[PATH_MAX];
@@ -549,7 +678,8 @@ bool visualize::runOnModule(Module &m)
 	   << " - Epoch: " << epochStr << "\n"
 	   << " - Output folder: " << path << "\n"
 	   << " - Web folder: " << webFolder << "\n"
-	   << " - Sync command: " << syncCommand << "\n";
+	   << (publishing() ? " - Publishing to the web folder\n"
+	       : " - Sync command: " + syncCommand + "\n");
   }
 					       
 
@@ -586,11 +716,21 @@ bool visualize::runOnModule(Module &m)
     }
   }
 
+  //Index every call in the module once, all views share it
+  auto cg_start = chrono::steady_clock::now();
+  build_call_graph(m);
+  auto cg_end = chrono::steady_clock::now();
+  if (VERBOSE) {
+    outs() << " - Call graph: " << callGraph.num_edges << " edges, "
+	   << callGraph.num_indirect << " indirect calls, built in "
+	   << format("%.1f", chrono::duration<double,milli>(cg_end - cg_start).count())
+	   << " ms\n";
+  }
+
   //Create the module control flow graph folder
   if (CREATE_CF_MODULE_VIEW) {
     string name = "Module_Control_" + get_name(&m);;
-    string command = "mkdir -p " + dataFolder + name;
-    system(command.c_str());
+    if (!SERVE_VIEWS) create_view_folder(name);
     folders.push_back(name);
   }
 
@@ -603,8 +743,7 @@ bool visualize::runOnModule(Module &m)
       	continue;
 	
       string name = "Function_Control_" + get_name(&f);
-      string command = "mkdir -p " + dataFolder + name;
-      system(command.c_str());
+      if (!SERVE_VIEWS) create_view_folder(name);
       folders.push_back(name);
     }
   }
@@ -619,21 +758,41 @@ bool visualize::runOnModule(Module &m)
       	continue;
       
       string name = "Function_Data_" + get_name(&f);
-      string command = "mkdir -p " + dataFolder + name;
-      system(command.c_str());
+      if (!SERVE_VIEWS) create_view_folder(name);
       folders.push_back(name);
     }
   }
 
+  //Keep the module resident and only build the views asked for
+  if (SERVE_VIEWS) {
+    serve_views(m,folders);
+    return false;
+  }
+
+  //Fingerprinting a function needs the IR hashes of the ones it calls
+  if (INCREMENTAL_EPOCHS) hash_functions(m);
+
   //Create the control flow view for the module. Functions are nodes,
   //with calls connecting the nodes.
   if (CREATE_CF_MODULE_VIEW) {
     create_control_flow_view(m,folders);
   }
 
-  //Create the control flow view. Each basic block is a node with the
-  //branches between the blocks represented as edges in the graph.
-  if (CREATE_CF_FUNCTION_VIEWS) {
+  //Build the function views concurrently. Name everything first so the
+  //threads only have to read the name table.
+  if (NUM_THREADS > 1) {
+    if (VERBOSE) outs() << "Creating function views on " << NUM_THREADS << " threads\n";
+    name_values(m);
+    create_function_views_in_parallel(m,folders);
+  }
+
+  //Create the control flow view, where each basic block is a node with
+  //the branches between the blocks represented as edges in the graph,
+  //and the data flow view, where arguments + global variables are
+  //inputs, and everything with no successor instruction is an output.
+  //Both views of a function are made together, so they share its
+  //fingerprint
+  if ((CREATE_CF_FUNCTION_VIEWS || CREATE_DF_FUNCTION_VIEWS) && NUM_THREADS <= 1) {
     for (Function &f : m) {
       if (f.isDeclaration()) continue;
       if (onlyDoFuns != "all" &&
@@ -642,33 +801,33 @@ bool visualize::runOnModule(Module &m)
 
       
       LoopInfo *LI = &getAnalysis<LoopInfoWrapperPass>(f).getLoopInfo();
-      create_control_flow_view(f,folders,LI);
+      string fingerprint = INCREMENTAL_EPOCHS ? get_fingerprint(f,LI) : "";
+      if (CREATE_CF_FUNCTION_VIEWS)
+	create_control_flow_view(f,folders,LI,fingerprint,outs());
+      if (CREATE_DF_FUNCTION_VIEWS)
+	create_data_flow_view(f,folders,LI,fingerprint,outs());
     }
   }
 
-  //Create the data flow view. Arguments + global variables are
-  //inputs, and everything with no successor instruction is an output
-  if (CREATE_DF_FUNCTION_VIEWS) {
-    for (Function &f : m) {
-      if (f.isDeclaration()) continue;
-      if (onlyDoFuns != "all" &&
-	  onlyDoFuns.find(get_name(&f)) == string::npos)
-      	continue;
-      
-      LoopInfo *LI = &getAnalysis<LoopInfoWrapperPass>(f).getLoopInfo();      
-      create_data_flow_view(f,folders,LI);
-
+  if (INCREMENTAL_EPOCHS && VERBOSE)
+    outs() << " - Function views reused: " << viewsReused
+	   << ", rebuilt: " << viewsRebuilt << "\n";
 
-    }
-  }
+  //Everything has to be on disk before it is published or synced
+  stop_writer();
 
-  if (DO_SYNC) {
+  if (publishing()) {
+    finish_publish();
+  } else if (DO_SYNC) {
     if (VERBOSE) outs() << "Running sync command: " << syncCommand << " ... ";
-
+    stage_timer timer(PUBLISH_STAGE);
+    system(syncCommand.c_str());
     if (VERBOSE) outs() << "Done\n";
   }
 
   
+  write_pass_report();
+
   if (VERBOSE) outs() << "-= LLVMVis Complete =-\n\n";
   //This pass did not make changes to the IR
   return false;
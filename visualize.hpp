@@ -6,37 +6,80 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/RWMutex.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringExtras.h"
 #include <fstream>
+#include <sstream>
 #include <dirent.h> //For DIR
 #include <iomanip>
 #include <string>
+#include <algorithm>
+#include <array>
 #include <unordered_map>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <regex>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <functional>
 #include <linux/limits.h>
 
 using namespace std;
 using namespace llvm;
 
+/*
+  Settings, set with opt's command line options (see
+  visualize_options.cpp and "opt -load visualize.so -help")
+*/
+//How much detail goes into each node
+enum detail_profile { SKELETON, STANDARD, FULL };
+extern cl::opt<detail_profile> PROFILE;
+
 /* General view settings */
-#define DO_SYNC true
-#define VERBOSE true
-#define REMOVE_DBG_FROM_IR true
-#define ENABLE_IR true /* Warning: +4x slow down */
-#define ENABLE_DEBUG true /* Warning: +6x slow down */
-#define ENABLE_DIFF true
-#define MAX_CODE_LENGTH 1000 /*Characters*/
+extern cl::opt<bool> DO_SYNC;
+extern cl::opt<bool> VERBOSE;
+extern cl::opt<bool> REMOVE_DBG_FROM_IR;
+extern cl::opt<bool> ENABLE_IR; /* Warning: +4x slow down */
+extern cl::opt<bool> ENABLE_DEBUG; /* Warning: +6x slow down */
+extern cl::opt<bool> ENABLE_DIFF;
+extern cl::opt<bool> PACK_DATA_FILES; /* One data.pack per view instead of .mkdn files */
+extern cl::opt<bool> STORE_DATA_OBJECTS; /* Node texts kept once in data/objects/, shared by all epochs */
+extern cl::opt<bool> BINARY_GRAPH; /* Also write objects.bin, which the front end loads instead of graph.json */
+enum compression_kind { NO_COMPRESSION, DEFLATE, ZSTD };
+extern cl::opt<compression_kind> COMPRESSION; /* How files only the front end reads are precompressed */
+extern cl::opt<unsigned> LAYOUT_NODES; /* Views this large are laid out by the pass, not the browser (0 for none) */
+extern cl::opt<unsigned> MAX_CODE_LENGTH; /*Characters*/
+extern cl::opt<unsigned> NUM_THREADS; /* >1 builds function views in parallel */
+extern cl::opt<bool> INCREMENTAL_EPOCHS; /* Reuse the last epoch's views of unchanged functions */
+extern cl::opt<bool> SERVE_VIEWS; /* Serve views on demand over HTTP instead of writing them */
+extern cl::opt<unsigned> SERVE_PORT; /* Port on 127.0.0.1 used by SERVE_VIEWS */
 
 /* View settings for MODULE CONTROL FLOW view */
-#define CREATE_CF_MODULE_VIEW true
+extern cl::opt<bool> CREATE_CF_MODULE_VIEW;
 #define SHOW_FUNCTION_DECLARATIONS false
 
 /* View settings for FUNCTION CONTROL FLOW views */
-#define CREATE_CF_FUNCTION_VIEWS true
+extern cl::opt<bool> CREATE_CF_FUNCTION_VIEWS;
 
 /* View settings for FUNCTION DATA FLOW views */
-#define CREATE_DF_FUNCTION_VIEWS true
+extern cl::opt<bool> CREATE_DF_FUNCTION_VIEWS;
 #define CONNECT_GLOBAL_VALUES true
 #define SHOW_INSTRUCTION_TYPE false //eg. i32
 #define SHOW_INSTRUCTION_GROUP false //eg. store
@@ -44,48 +87,126 @@ using namespace llvm;
 #define GROUP_DF_BY_CF false
 
 //The root address used in hyperlinks
-static string root_address = "http://137.82.252.51/graph.php?dataset=";
-static string dataFolder = "data/";
+extern cl::opt<string> root_address;
+extern cl::opt<string> dataRoot; //Holds one epochN folder per run
+static string dataFolder; //This run's epochN folder in dataRoot
 
 //Other addresses
-static string epochFile = "/var/www/html/data/count.txt";
-static string webFolder = "/var/www/html/data/";
-static string syncCommand = "rsync -az " + dataFolder + " " + webFolder;
+extern cl::opt<string> epochFile;
+extern cl::opt<string> webFolder;
+extern cl::opt<string> syncCommand; //Run once at the end instead of publishing, if set
 
 //Only make views of particular functions (enter "all" to do all)
-static string onlyDoFuns = "all";
+extern cl::opt<string> onlyDoFuns;
 
 //List of functions names that will be hidden from all views
-static string hideCallsTo = "puts,printf,llvm.dbg.value";
+extern cl::opt<string> hideCallsTo;
+
+//Where the run's JSON report and Chrome trace are written, if anywhere
+extern cl::opt<string> REPORT_FILE;
+extern cl::opt<string> TRACE_FILE;
+
+//Fill in the settings left to the profile. Called once the command
+//line is parsed, before any view is made
+void apply_options();
+
+//True if nodes have texts to write. The skeleton profile (no IR and no
+//debug info) writes none
+bool writes_node_texts();
 
 //Header in the markdown file to provide syntax highlighting
 static string prettify_theme = "default"; //Options found in code-prettify/styles
 static string syntax_beg = "<pre class=\"prettyprint lang-llvm \">";
 static string syntax_end = "</pre>\n";
 
-//Names for loops and he unnamed
+//Names for loops and he unnamed. loopIDs is filled before any view
+//is made, nameMap is guarded by nameLock as views may share it
 extern unordered_map<BasicBlock*,string> loopIDs;
 extern unordered_map<Value*,string> nameMap;
+extern sys::SmartRWMutex<true> nameLock;
 extern int current_epoch;
 
+//Index of every call in the module. Built in a single sweep at the
+//start of the pass, so views never have to rescan the module to find
+//who calls who.
+struct call_graph {
+  unordered_map<Function*,vector<Function*>> callers; //Functions calling a function
+  unordered_map<Function*,vector<Function*>> called;  //Functions a function calls
+  DenseMap<pair<Function*,Function*>,int> calls;       //Number of calls on each edge
+  int num_edges = 0;
+  int num_indirect = 0; //Calls through function pointers
+};
+extern call_graph callGraph;
+
+//What a constraint controls
+enum constraint_kind {
+  POSITION_X,    //Where the node is placed along the x axis
+  POSITION_Y,    //Where the node is placed along the y axis
+  NODE_STRENGTH, //Strength of all the node's links
+  NODE_WIDTH,    //Width of all the node's links
+  LINK_STRENGTH, //Strength of the link to one target
+  LINK_WIDTH,    //Width of the link to one target
+  LINK_COLOR     //Color of the link to one target
+};
+
+struct node;
+struct view_arena;
+
 //Container for node position, and various link settings such as edge
 //width, and color. Constraints are optional, but without them nodes
 //positioning and layout is governed entirely by the force algorithm.
+//Values are kept as numbers and only turned into text when config.json
+//is written.
 struct constraint {
-  string name, type, X, Y, value, weight;
+  constraint_kind kind;
+  node *source;        //The node this constraint is set on
+  node *target;        //Other end of the link (LINK_* only)
+  float value, weight;
+  string color;        //LINK_COLOR only
 };
 
 //Container to hold the nodes and various properties about them. Todo:
 //more documentation here.
 struct node {
-  string name, type, group, metadata, src, json;
+  string name, type, group, metadata, src;
   vector<string> depends;
   vector<constraint*> constraints;
   Value *original;
-  node() { original = NULL; }
-  node(Value *val) { original = val; }
+  bool self_loop;    //Written with a dummy node, see create_self_loop
+  view_arena *arena; //Where this node, and its constraints, live
+  node(view_arena *a, Value *val = NULL) {
+    arena = a; original = val; self_loop = false;
+  }
+};
+
+//Storage for the nodes and constraints of a single view. They are
+//bump allocated and freed all at once when the view has been written
+//and the arena goes out of scope.
+struct view_arena {
+  SpecificBumpPtrAllocator<node> nodes;
+  SpecificBumpPtrAllocator<constraint> constraints;
 };
 
+//Create a node, or a constraint on a node, inside a view's arena
+node *create_node(view_arena &arena, Value *val = NULL);
+constraint *create_constraint(node *n, constraint_kind kind);
+
+//A view that has been built in memory, but not written anywhere yet
+enum view_kind { CONTROL_FLOW_VIEW, DATA_FLOW_VIEW };
+
+struct view {
+  string title;
+  view_kind kind = CONTROL_FLOW_VIEW;
+  view_arena arena;
+  vector<node*> nodes;
+};
+
+//Build the nodes of a view, without writing anything. 'log' gets the
+//progress dots
+void build_control_flow_view(Module &m, vector<string> folders, view &v, raw_ostream &log);
+void build_control_flow_view(Function &f, vector<string> folders, LoopInfo *LI, view &v, raw_ostream &log);
+void build_data_flow_view(Function &f, vector<string> folders, LoopInfo *LI, view &v, raw_ostream &log);
+
 
 /* 
    Graph building and configuration - in create_object.cpp
@@ -93,8 +214,14 @@ struct node {
 //Create the configuation settings for the graph
 vector<int> get_config(int nodes);
 
-//Create a node in the graph to be written into objects.json
-string create_object(node *n);
+//Name every value the views may refer to. Done once before views are
+//built so the name table is only read from while they run
+void name_values(Module &m);
+
+//Name the arguments, blocks and instructions of one function, and the
+//global values it uses. Unnamed values are named after a hash of what
+//they are and where they are in the function
+void name_function_values(Function &f);
 
 //Standardized format for getting names of things
 string get_name(Value *v);
@@ -115,12 +242,12 @@ string get_group(Value *v);
 
 //Create the metadata shown on the right side bar, code is user defined.
 string get_ir(Function *f);
-string get_ir(BasicBlock*b);
+string get_ir(BasicBlock*b, ModuleSlotTracker *MST = nullptr);
 string get_debug(Function *f);
-string get_blk_metadata(BasicBlock *b);
+string get_blk_metadata(BasicBlock *b, ModuleSlotTracker *MST = nullptr);
 string get_file(Function *f);
 string get_dir(Function *f);
-string prep_metadata(string code);
+string prep_metadata(const string &code);
 
 //Set constraints on where the nodes are placed
 void set_Y_position(node *n, float loc, float weight);
@@ -136,16 +263,31 @@ void set_link_width(node *source, node *target, float value);
 void set_link_color(node *source, node *target, string value);
 
 
+//The hide() decision for every instruction of a function, made once
+//per view. Instructions are numbered in the order they are in the
+//function, so a loop over all of them can use the bits directly.
+struct hidden_instructions {
+  BitVector hidden;
+  DenseMap<const Instruction*,unsigned> numbers;
+
+  hidden_instructions(Function &f);
+  bool operator[](unsigned number) const { return hidden[number]; }
+};
+bool hide(Instruction &i, const hidden_instructions &hidden);
+
 /*
   Helpful/additional function/loop nodes. These are placed in the top
   right and corner and are used to access more metadata
 */
-node* create_function_node(Function *f, vector<string> folders, bool links);
-node *create_loop_node(Loop *l, vector<string> folders, bool control_flow);
+node* create_function_node(Function *f, vector<string> folders, bool links, view_arena &arena);
+node *create_loop_node(Loop *l, vector<string> folders, bool control_flow, view_arena &arena,
+			ModuleSlotTracker *MST = nullptr,
+			const hidden_instructions *hidden = nullptr);
 
 
 //Find the "inputs" and "outputs" of the function. (Modified from CodeExtractor)
-void findInputOutputs(Function *f, vector<Value*> &Inputs, vector<Value*> &Outputs);
+void findInputOutputs(Function *f, const hidden_instructions &hidden,
+		      SetVector<Value*> &Inputs, SetVector<Value*> &Outputs);
 
 
 /*
@@ -163,6 +305,9 @@ string change_blocks_to_links(Function *f, string input);
 //Return true for instructions we wish to hide
 bool hide(Value &i);
 
+//Return true for functions in hideCallsTo, whose calls are hidden
+bool hidden_callee(Function *f);
+
 
 /* 
    LLVM Helper Functions 
@@ -170,8 +315,10 @@ bool hide(Value &i);
 //Replaces all occurences of "from", in string "str", with "to" 
 void replaceAll(std::string& str, const std::string& from, const std::string& to);
 
-//Returns the print() of an object. This is used in metadata creation
-string print(Value *i);
+//Returns the print() of an object. This is used in metadata creation.
+//Views share one ModuleSlotTracker for all their prints, otherwise
+//LLVM numbers the whole function again for every value printed
+string print(Value *i, ModuleSlotTracker *MST = nullptr);
 string print(Metadata *m);
 
 //Returns the pointer address for a value. Used to provide a unique ID
@@ -186,6 +333,9 @@ int numParents(BasicBlock *b);
 //Make strings nice
 string sanitize(string name);
 
+//Build the call graph index for the whole module
+void build_call_graph(Module &m);
+
 //Find all the functions that call this function
 vector<Function*> find_callers(Function *source);
 
@@ -200,18 +350,60 @@ int count_calls(Function *source, Function *target);
 /* 
    JSON file writing stuff
 */
-//Create a string of objects that constains all the nodes which will
-//be written to file
-string create_json_object(string name, string type, string group, vector<string> depends);
+//Write a quoted json string, escaping anything json doesn't allow
+void write_json_string(raw_ostream &OS, StringRef str);
+
+//What graph.json and objects.bin hold. Change it with them, so views
+//of earlier epochs in the old format aren't reused
+#define GRAPH_FORMAT "graph.json 2, objects.bin LVG3"
+
+//Write the contents of graph.json: the nodes with their edges in both
+//directions, how each edge is drawn, the depends that name no node and,
+//for large views, where each node goes (see visualize_graph.cpp)
+void write_graph(raw_ostream &OS, const view &v);
+
+//Create graph.json, and the same graph in the compact binary form of
+//objects.bin
+void create_graph_files(string folder, const view &v);
+
+/*
+  Layout - in visualize_layout.cpp
+*/
+//Where a node goes, from 0 to 1 across and down the graph area
+struct layout_point {
+  float x, y;
+};
+
+//Where a node is pulled to by its position constraints, if anywhere
+struct layout_anchor {
+  float x = 0, y = 0;
+  float x_weight = 0, y_weight = 0;
+};
+
+//Lay out a graph in layers, its edges pointing down. 'sources' holds
+//the nodes each node's edges come from, and anchored nodes keep to
+//their anchors. Used for control flow views
+vector<layout_point> layered_layout(const vector<vector<uint32_t>> &sources,
+				    const vector<layout_anchor> &anchors);
+
+//Lay out a graph with forces, starting from its layered layout. Used
+//for data flow views
+vector<layout_point> force_layout(const vector<vector<uint32_t>> &sources,
+				  const vector<layout_anchor> &anchors);
+
+//Write the node types which will be saved in the config file
+void write_config_types(raw_ostream &OS, const vector<node*> &nodes);
 
-//Create objects.json which stores all objects
-void create_objects_file(string folder, vector<node*> nodes);
+//Turn a constraint into the text fields used in config.json
+void format_constraint(constraint *c, string &type, string &X, string &value,
+		       string &Y, string &weight);
 
-//Create the node types which will be saved in the config file
-string create_config_types(vector<node*> nodes);
+//Write the node constraints which will be saved in the config file
+void write_config_constraints(raw_ostream &OS, const vector<node*> &nodes);
 
-//Create the node constraints which will be saved in the config file
-string create_config_constraints(vector<node*> nodes);
+//Write the contents of config.json
+void write_config(raw_ostream &OS, vector<int> config, string title,
+		  const vector<node*> &nodes);
 
 //Create the configuration file that determines the size of the
 //graphing area, the forces used to layout the nodes and padding
@@ -219,9 +411,195 @@ string create_config_constraints(vector<node*> nodes);
 void create_config_file(vector<int> config,
 			string folder,
 			string title,
-			vector<node*> nodes);
+			const vector<node*> &nodes);
+
+//What writing a view's metadata did: how much changed since the last
+//epoch, how long it took to find out, and what went into the object
+//store
+struct data_stats {
+  unsigned changed = 0; //Nodes whose IR differs from the last epoch
+  unsigned added = 0;   //Nodes that weren't in the last epoch
+  double ms = 0;
+  unsigned stored = 0;  //New objects written to the store
+  unsigned reused = 0;  //Texts that were already in the store
+  uint64_t stored_bytes = 0;
+};
 
 //  Create the metadata files, one for each node. Saved into the
 //  folder of that view with the filename of <object_name>.mkdn. This
-//  file supports markdown formatting and javascript
-void create_data_files(string folder, vector<node*> nodes);
+//  file supports markdown formatting and javascript. Nothing is
+//  written if the nodes have no texts.
+data_stats create_data_files(string folder, vector<node*> nodes);
+
+//Write a view's graph.json, config.json and metadata into 'folder'
+data_stats write_view(string folder, view &v);
+
+//The texts kept for every node, in the order they are packed
+enum data_kind { IR_DATA, SRC_DATA, DIFF_DATA, NUM_DATA_KINDS };
+
+//Where a node's texts are within data.pack
+struct pack_entry {
+  uint64_t offset[NUM_DATA_KINDS];
+  uint64_t length[NUM_DATA_KINDS];
+};
+typedef unordered_map<string,pack_entry> pack_index;
+
+//  Create the packed metadata for a view. Every node's texts are
+//  concatenated into data.pack, and data.index holds one line per node:
+//  <name> <ir offset> <ir length> <src offset> <src length> <diff
+//  offset> <diff length>, separated by tabs.
+data_stats create_packed_data_files(string folder, vector<node*> nodes);
+
+//Read data.index of a packed view. Returns false if the view isn't packed
+bool read_pack_index(string folder, pack_index &index);
+
+//The hashes of a node's texts in the object store
+typedef unordered_map<string,array<string,NUM_DATA_KINDS> > ref_index;
+
+//  Create the metadata of a view in the object store. Each text is
+//  saved once as data/objects/<2 digits of hash>/<rest of hash>, and
+//  data.refs holds one line per node: <name> <ir hash> <src hash>
+//  <diff hash>, separated by tabs.
+data_stats create_object_data_files(string folder, vector<node*> nodes);
+
+//Where the object with this hash is kept
+string object_path(StringRef hash);
+
+//Save 'text' in the object store if it isn't already there, and
+//return its hash
+string store_object(StringRef text, data_stats &stats);
+
+//Read data.refs of a view in the object store. Returns false if the
+//view isn't in the store
+bool read_ref_index(string folder, ref_index &index);
+
+//The same view in the last epoch, which this one is diffed against
+struct last_epoch_view {
+  string folder;
+  bool packed = false;
+  pack_index index;
+  unique_ptr<MemoryBuffer> pack;
+  bool stored = false;
+  ref_index refs;
+};
+
+//The folder of the same view in the last epoch, or "" if this is the
+//first epoch
+string last_epoch_folder(string folder);
+
+//Find the last epoch of the view in 'folder'. Returns false if there
+//is no last epoch
+bool open_last_epoch(string folder, last_epoch_view &last);
+
+//Read a node's IR from the last epoch. Returns false if the node
+//wasn't there
+bool read_last_epoch(last_epoch_view &last, const string &name, string &text);
+
+//Diff a node's IR against the last epoch, counting it in 'stats'
+string diff_last_epoch(last_epoch_view &last, node *n, data_stats &stats);
+
+//Diff two texts line by line, in the same format diff prints
+string diff_lines(StringRef before, StringRef after);
+
+//How many function views were reused and rebuilt this epoch
+extern atomic<unsigned> viewsReused, viewsRebuilt;
+
+//Hash the IR of every function in the module, before any view is made
+void hash_functions(Module &m);
+
+//Fingerprint everything that goes into the views of 'f'
+string get_fingerprint(Function &f, LoopInfo *LI);
+
+//The folder a view's files are really in, following origin.txt if
+//the view was reused from an earlier epoch
+string resolve_view_folder(string folder);
+
+//Save the fingerprint of a view that was just built, once its files
+//are written
+void write_fingerprint(string folder, const string &fingerprint);
+
+//Reuse the last epoch's view if it was made from the same
+//fingerprint. Returns false if the view has to be built.
+bool reuse_view(string folder, const string &fingerprint);
+
+/*
+  Background writing - in visualize_writer.cpp
+*/
+//Write 'text' to 'path' on the writer thread. Waits first if the
+//writer has fallen too far behind. Files only the front end reads can
+//be 'compressed', they are then written as path.deflate or path.zst
+//when -visualize-compress is given
+void write_file(string path, string text, bool compressed = false);
+
+//Run 'task' on the writer thread once every file queued before it is
+//written
+void after_writes(function<void()> task);
+
+//Whether every file queued into 'folder' so far was written. Only for
+//tasks given to after_writes
+bool folder_written(StringRef folder);
+
+//Write what is left and stop the writer thread, at the end of the pass
+void stop_writer();
+
+/*
+  Publishing to the web folder - in visualize_publish.cpp
+*/
+//Views are linked into a staging copy of the epoch in the web folder
+//as they are written. finish_publish renames it into place and then
+//writes the epoch count. publishing() is whether this run publishes
+//(rather than running a sync command at the end).
+bool publishing();
+void begin_publish();
+void publish_view(string folder);
+void publish_object(const string &path);
+void finish_publish();
+
+//Keep the module in memory and serve its views over HTTP on
+//SERVE_PORT, building each one the first time it is asked for. Only
+//returns if the server can't be started.
+void serve_views(Module &m, vector<string> folders);
+
+/*
+  Instrumentation - in visualize_report.cpp
+*/
+//The stages of a run that are timed
+enum pass_stage {
+  NAMING_STAGE,   //Naming values
+  GRAPH_STAGE,    //Building nodes and edges
+  IR_STAGE,       //Printing IR
+  DEBUG_STAGE,    //Reading debug info
+  SANITIZE_STAGE, //prep_metadata
+  JSON_STAGE,     //graph.json, objects.bin and config.json
+  WRITE_STAGE,    //Making the data files and handing them to the writer
+  DIFF_STAGE,     //Diffing against the last epoch
+  PUBLISH_STAGE,  //Publishing to the web folder, or the sync command
+  LAYOUT_STAGE,   //Laying out large views
+  WRITER_STAGE,   //The writer thread, which overlaps the stages above
+  NUM_STAGES
+};
+
+//Times a stage from when it is made until it goes out of scope. Time
+//in a stage started inside it only counts for that one, so the stages
+//add up to the time they cover.
+class stage_timer {
+  pass_stage stage;
+  chrono::steady_clock::time_point start;
+  double inner_ms = 0;
+  stage_timer *outer;
+public:
+  stage_timer(pass_stage s);
+  ~stage_timer();
+};
+
+//Record the view this thread builds between these two calls
+void begin_view_report(const string &title);
+void end_view_report(const view &v);
+
+//Count files (and their bytes) written into the data folder
+void count_written(uint64_t bytes, unsigned files = 1);
+
+//Start the clock, and at the end write -visualize-report and
+//-visualize-trace, and the stage times if -time-passes is on
+void begin_pass_report();
+void write_pass_report();
@@ -0,0 +1,147 @@
+#include "visualize.hpp"
+
+//////////////////////////////////////////////////////////////////
+// Line diff - Compares a node's metadata with the last epoch	//
+// in process, instead of running diff once for every node.	//
+//////////////////////////////////////////////////////////////////
+
+//Past this many differences the texts are reported as replaced
+//outright, which keeps the memory used by the trace bounded
+#define MAX_DIFF_EDITS 4096
+
+//One line of a text. Lines are compared by 'id' only
+struct diff_line {
+  int id;
+  StringRef text; //Without the newline
+  bool newline;   //False for a last line that has no newline
+};
+
+//The steps that turn one text into the other
+enum diff_edit { KEEP, REMOVE, ADD };
+
+//Split 'text' into lines, giving every distinct line a number in
+//'ids' so lines can be compared as integers. Like diff, a last line
+//without a newline is not the same as one with it.
+static void intern_lines(StringRef text, StringMap<int> &ids, vector<diff_line> &lines) {
+  while (!text.empty()) {
+    size_t end = text.find('\n');
+    bool newline = end != StringRef::npos;
+    StringRef key = newline ? text.substr(0,end + 1) : text;
+    auto id = ids.insert(make_pair(key,(int)ids.size())).first;
+    lines.push_back({id->second, newline ? key.drop_back() : key, newline});
+    text = text.substr(key.size());
+  }
+}
+
+//Myers' O(ND) diff. trace[d] keeps how far along every diagonal the
+//search got with d-1 differences, which is then walked backwards to
+//find the edits. Returns false if there are more than MAX_DIFF_EDITS.
+static bool myers_diff(const vector<diff_line> &a, const vector<diff_line> &b,
+		       vector<diff_edit> &edits) {
+  int n = a.size(), m = b.size();
+  int offset = n + m + 1;
+  vector<int> v(2 * offset + 1, 0);
+  vector<vector<int> > trace;
+
+  int edit_count = -1;
+  for (int d = 0; d <= n + m && edit_count < 0; d++) {
+    if (d > MAX_DIFF_EDITS) return false;
+    trace.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+    for (int k = -d; k <= d; k += 2) {
+      int x;
+      if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+	x = v[offset + k + 1];
+      else
+	x = v[offset + k - 1] + 1;
+      int y = x - k;
+      while (x < n && y < m && a[x].id == b[y].id) { x++; y++; }
+      v[offset + k] = x;
+      if (x >= n && y >= m) {
+	edit_count = d;
+	break;
+      }
+    }
+  }
+
+  //Walk back from the end, one difference at a time
+  int x = n, y = m;
+  for (int d = edit_count; d > 0; d--) {
+    const vector<int> &last = trace[d]; //Indexed by k + d
+    int k = x - y;
+    int last_k = (k == -d || (k != d && last[k - 1 + d] < last[k + 1 + d])) ? k + 1 : k - 1;
+    int last_x = last[last_k + d];
+    int last_y = last_x - last_k;
+    while (x > last_x && y > last_y) { edits.push_back(KEEP); x--; y--; }
+    edits.push_back(x == last_x ? ADD : REMOVE);
+    x = last_x;
+    y = last_y;
+  }
+  while (x > 0 && y > 0) { edits.push_back(KEEP); x--; y--; }
+  reverse(edits.begin(),edits.end());
+  return true;
+}
+
+//Write a range of line numbers the way diff does, "3" or "3,5"
+static void write_range(raw_ostream &OS, int first, int last) {
+  OS << first;
+  if (last > first) OS << "," << last;
+}
+
+//Write lines [from,to) with 'prefix' in front of each
+static void write_lines(raw_ostream &OS, StringRef prefix,
+			const vector<diff_line> &lines, int from, int to) {
+  for (int i = from; i < to; i++) {
+    OS << prefix << lines[i].text << "\n";
+    if (!lines[i].newline) OS << "\\ No newline at end of file\n";
+  }
+}
+
+//Diff two texts line by line. The result is in the same "normal"
+//format diff prints, which is what the web front end shows.
+string diff_lines(StringRef before, StringRef after) {
+  StringMap<int> ids;
+  vector<diff_line> a, b;
+  intern_lines(before,ids,a);
+  intern_lines(after,ids,b);
+
+  vector<diff_edit> edits;
+  if (!myers_diff(a,b,edits)) {
+    edits.assign(a.size(),REMOVE);
+    edits.insert(edits.end(),b.size(),ADD);
+  }
+
+  string diff;
+  raw_string_ostream OS(diff);
+  int x = 0, y = 0;
+  size_t i = 0;
+  while (i < edits.size()) {
+    if (edits[i] == KEEP) {
+      x++; y++; i++;
+      continue;
+    }
+
+    //A hunk is a run of removed and added lines
+    int first_x = x, first_y = y;
+    for (; i < edits.size() && edits[i] != KEEP; i++) {
+      if (edits[i] == REMOVE) x++;
+      else y++;
+    }
+
+    if (y == first_y) {
+      write_range(OS,first_x + 1,x);
+      OS << "d" << y;
+    } else if (x == first_x) {
+      OS << x << "a";
+      write_range(OS,first_y + 1,y);
+    } else {
+      write_range(OS,first_x + 1,x);
+      OS << "c";
+      write_range(OS,first_y + 1,y);
+    }
+    OS << "\n";
+    write_lines(OS,"< ",a,first_x,x);
+    if (x > first_x && y > first_y) OS << "---\n";
+    write_lines(OS,"> ",b,first_y,y);
+  }
+  return OS.str();
+}
@@ -0,0 +1,370 @@
+#include "visualize.hpp"
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+//////////////////////////////////////////////////////////////////
+// Graph files - graph.json and objects.bin. The edges of a view //
+// are resolved once here, in both directions and with how they	//
+// are drawn, so the front end only has to read them.		//
+//////////////////////////////////////////////////////////////////
+
+//graph.json is what json.php sends the browser:
+//
+//  {"data" : {"<name>" : {"type", "name", "group", "depends",
+//			   "dependedOnBy", "links"}, ...},
+//   "errors" : ["Unrecognized dependency: ...", ...]}
+//
+//"links" has one entry per edge into the node, {"source", "strength",
+//"width", "color"}, with the link constraints of config.json applied.
+//Depends on nodes that aren't in the view are in "depends", but have no
+//link, and are listed in "errors". Views of -visualize-layout-nodes
+//nodes or more are laid out in the pass (see visualize_layout.cpp), and
+//their nodes have "layout" : [x, y] too, from 0 to 1 across and down.
+//
+//objects.bin holds the same nodes, in the same order, in less space.
+//Nodes are numbered by that order and every name, type, group and
+//color is a number in a table of strings. Everything is little endian
+//and 4 byte aligned:
+//
+//  "LVG3"
+//  u32 strings, nodes, edges, styles, errors
+//  u32 string_end[strings]   Where each string ends in the text
+//  u32 name[nodes]           String numbers of each node
+//  u32 type[nodes]
+//  u32 group[nodes]
+//  u32 first_edge[nodes + 1] The edges of node i are first_edge[i] up
+//                            to first_edge[i + 1] (its depends)
+//  u32 source[edges]         The node each edge comes from
+//  u32 style[edges]          How each edge is drawn, a number in:
+//  f32 strength[styles]      Each distinct way an edge is drawn
+//  f32 width[styles]
+//  u32 color[styles]         String number
+//  f32 x[nodes]              Where each node goes, NaN if the view
+//  f32 y[nodes]              isn't laid out
+//  u32 error[errors]         String numbers of the "errors" of graph.json
+//  u8  text[]                The strings, in UTF-8
+//
+//Its decoder is decodeGraph() in www/html/script.js.
+
+#define GRAPH_MAGIC "LVG3" //Also in GRAPH_FORMAT
+#define DEFAULT_LINK_COLOR "green"
+
+//An edge into a node, as it is drawn
+struct graph_edge {
+  uint32_t source;
+  float strength, width;
+  StringRef color;
+};
+
+//A node as it is written, which may be a self loop dummy
+struct graph_node {
+  StringRef name, type, group;
+  vector<StringRef> depends;
+  vector<graph_edge> edges; //The depends that are in the view
+  vector<uint32_t> dependedOnBy;
+  node *original; //Null for dummies, which have no constraints
+  layout_point at;
+};
+
+//The nodes of a view with their edges resolved
+struct view_graph {
+  vector<graph_node> nodes;
+  vector<string> dummyNames; //Reserved up front, so the names never move
+  vector<string> errors;
+  bool laid_out = false;
+};
+
+//How a link is drawn. Negative (or null) fields are left to the node
+//the link goes to.
+struct link_style {
+  float strength = -1, width = -1;
+  const string *color = nullptr;
+};
+
+//List the nodes, with a dummy after each node that has a self loop
+//(see create_self_loop)
+static void add_graph_nodes(const vector<node*> &nodes, view_graph &graph) {
+  graph.dummyNames.reserve(nodes.size());
+  graph.nodes.reserve(nodes.size());
+  for (node *n : nodes) {
+    graph_node g;
+    g.name = n->name;
+    g.type = n->type;
+    g.group = n->group;
+    g.original = n;
+    g.depends.assign(n->depends.begin(),n->depends.end());
+    if (!n->self_loop) {
+      graph.nodes.push_back(std::move(g));
+      continue;
+    }
+
+    graph.dummyNames.push_back(n->name + "_SelfLoop");
+    g.depends.push_back(graph.dummyNames.back());
+    graph.nodes.push_back(std::move(g));
+
+    graph_node dummy;
+    dummy.name = graph.dummyNames.back();
+    dummy.type = n->type;
+    dummy.group = n->group;
+    dummy.original = nullptr;
+    dummy.depends.push_back(n->name);
+    graph.nodes.push_back(std::move(dummy));
+  }
+}
+
+//Place the nodes of a large view: control flow in layers from the entry
+//down, and data flow with forces, both keeping to the position constraints
+static void layout_graph(view_kind kind, view_graph &graph) {
+  stage_timer timer(LAYOUT_STAGE);
+  vector<vector<uint32_t>> sources(graph.nodes.size());
+  vector<layout_anchor> anchors(graph.nodes.size());
+  for (size_t i = 0; i < graph.nodes.size(); i++) {
+    const graph_node &g = graph.nodes[i];
+    //Edges with no strength (such as the invisible ones of loop
+    //nodes) don't pull, so they are left out
+    for (const graph_edge &edge : g.edges)
+      if (edge.strength > 0)
+	sources[i].push_back(edge.source);
+    if (!g.original) continue;
+    for (constraint *c : g.original->constraints) {
+      if (c->kind == POSITION_X) {
+	anchors[i].x = c->value;
+	anchors[i].x_weight = c->weight;
+      } else if (c->kind == POSITION_Y) {
+	anchors[i].y = c->value;
+	anchors[i].y_weight = c->weight;
+      }
+    }
+  }
+
+  vector<layout_point> points = kind == DATA_FLOW_VIEW
+    ? force_layout(sources,anchors) : layered_layout(sources,anchors);
+  for (size_t i = 0; i < graph.nodes.size(); i++)
+    graph.nodes[i].at = points[i];
+  graph.laid_out = true;
+}
+
+//Resolve the edges of a view: find the node each depend names, how the
+//edge is drawn, and the reverse edges. Large views are laid out too
+static void build_graph(const view &v, view_graph &graph) {
+  const vector<node*> &nodes = v.nodes;
+  add_graph_nodes(nodes,graph);
+
+  StringMap<uint32_t> nodeIds;
+  for (uint32_t i = 0; i < graph.nodes.size(); i++)
+    nodeIds.insert(make_pair(graph.nodes[i].name,i));
+
+  //The link constraints, by the names of the nodes at both ends. The
+  //nodes a constraint points at are often made only to carry a name,
+  //so names are matched, as script.js did. Later ones win
+  map<pair<StringRef,StringRef>,link_style> linkStyles;
+  for (node *n : nodes)
+    for (constraint *c : n->constraints) {
+      if (c->kind != LINK_STRENGTH && c->kind != LINK_WIDTH && c->kind != LINK_COLOR)
+	continue;
+      link_style &style = linkStyles[make_pair(StringRef(c->source->name),StringRef(c->target->name))];
+      if (c->kind == LINK_STRENGTH) style.strength = c->value;
+      else if (c->kind == LINK_WIDTH) style.width = c->value;
+      else style.color = &c->color;
+    }
+
+  for (uint32_t i = 0; i < graph.nodes.size(); i++) {
+    graph_node &g = graph.nodes[i];
+
+    //Links into a node are drawn with its strength and width, unless
+    //the node they come from says otherwise
+    float strength = 1, width = 1;
+    if (g.original)
+      for (constraint *c : g.original->constraints) {
+	if (c->kind == NODE_STRENGTH) strength = c->value;
+	else if (c->kind == NODE_WIDTH) width = c->value;
+      }
+
+    for (StringRef dep : g.depends) {
+      auto source = nodeIds.find(dep);
+      if (source == nodeIds.end()) {
+	graph.errors.push_back("Unrecognized dependency: '" + g.name.str()
+			       + "' depends on '" + dep.str() + "'");
+	continue;
+      }
+
+      link_style style;
+      auto found = linkStyles.find(make_pair(graph.nodes[source->second].name,g.name));
+      if (found != linkStyles.end()) style = found->second;
+
+      graph_edge edge;
+      edge.source = source->second;
+      edge.strength = style.strength < 0 ? strength : style.strength;
+      edge.width = style.width < 0 ? width : style.width;
+      edge.color = style.color ? StringRef(*style.color) : StringRef(DEFAULT_LINK_COLOR);
+      g.edges.push_back(edge);
+      graph.nodes[source->second].dependedOnBy.push_back(i);
+    }
+  }
+
+  if (LAYOUT_NODES && nodes.size() >= LAYOUT_NODES)
+    layout_graph(v.kind,graph);
+}
+
+//Numbers each string the first time it is seen
+struct string_table {
+  StringMap<uint32_t> ids;
+  vector<StringRef> strings;
+
+  uint32_t get(StringRef s) {
+    auto found = ids.insert(make_pair(s,(uint32_t)strings.size()));
+    if (found.second)
+      strings.push_back(found.first->getKey());
+    return found.first->second;
+  }
+};
+
+static void write_u32(raw_ostream &OS, uint32_t v) {
+  char bytes[4] = {(char)v, (char)(v >> 8), (char)(v >> 16), (char)(v >> 24)};
+  OS.write(bytes,4);
+}
+
+static void write_f32(raw_ostream &OS, float f) {
+  uint32_t v;
+  memcpy(&v,&f,sizeof(v));
+  write_u32(OS,v);
+}
+
+//Write the contents of objects.bin
+static void write_binary_graph(raw_ostream &OS, const view_graph &graph) {
+  string_table strings;
+  vector<uint32_t> names, types, groups, firstEdge, sources, edgeStyles, colors;
+  vector<float> strengths, widths;
+  map<tuple<float,float,uint32_t>,uint32_t> styles;
+  for (const graph_node &g : graph.nodes) {
+    names.push_back(strings.get(g.name));
+    types.push_back(strings.get(g.type));
+    groups.push_back(strings.get(g.group));
+    firstEdge.push_back(sources.size());
+
+    for (const graph_edge &edge : g.edges) {
+      sources.push_back(edge.source);
+      auto drawn = make_tuple(edge.strength,edge.width,strings.get(edge.color));
+      auto found = styles.insert(make_pair(drawn,(uint32_t)styles.size()));
+      if (found.second) {
+	strengths.push_back(edge.strength);
+	widths.push_back(edge.width);
+	colors.push_back(get<2>(drawn));
+      }
+      edgeStyles.push_back(found.first->second);
+    }
+  }
+  firstEdge.push_back(sources.size());
+  vector<uint32_t> errors;
+  for (const string &error : graph.errors)
+    errors.push_back(strings.get(error));
+
+  OS << GRAPH_MAGIC;
+  write_u32(OS,strings.strings.size());
+  write_u32(OS,graph.nodes.size());
+  write_u32(OS,sources.size());
+  write_u32(OS,styles.size());
+  write_u32(OS,errors.size());
+
+  uint32_t end = 0;
+  for (StringRef s : strings.strings)
+    write_u32(OS,end += s.size());
+  for (const vector<uint32_t> *column : {&names,&types,&groups,&firstEdge,&sources,&edgeStyles})
+    for (uint32_t v : *column)
+      write_u32(OS,v);
+  for (float v : strengths) write_f32(OS,v);
+  for (float v : widths) write_f32(OS,v);
+  for (uint32_t v : colors) write_u32(OS,v);
+  for (const graph_node &g : graph.nodes) write_f32(OS,graph.laid_out ? g.at.x : NAN);
+  for (const graph_node &g : graph.nodes) write_f32(OS,graph.laid_out ? g.at.y : NAN);
+  for (uint32_t v : errors) write_u32(OS,v);
+  for (StringRef s : strings.strings)
+    OS << s;
+}
+
+//Write a list of node names, by their numbers
+static void write_json_names(raw_ostream &OS, const view_graph &graph,
+			     const vector<uint32_t> &ids) {
+  OS << "[";
+  for (size_t i = 0; i < ids.size(); i++) {
+    OS << (i ? ", " : "");
+    write_json_string(OS,graph.nodes[ids[i]].name);
+  }
+  OS << "]";
+}
+
+static void write_json_graph(raw_ostream &OS, const view_graph &graph) {
+  OS << "{\n\t\"data\" : {";
+  bool first = true;
+  for (const graph_node &g : graph.nodes) {
+    OS << (first ? "\n\t\t" : ",\n\t\t");
+    first = false;
+    write_json_string(OS,g.name);
+    OS << " : {\n\t\t\t\"type\" : "; write_json_string(OS,g.type);
+    OS << ",\n\t\t\t\"name\" : "; write_json_string(OS,g.name);
+    OS << ",\n\t\t\t\"group\" : "; write_json_string(OS,g.group);
+
+    OS << ",\n\t\t\t\"depends\" : [";
+    for (size_t i = 0; i < g.depends.size(); i++) {
+      OS << (i ? ", " : "");
+      write_json_string(OS,g.depends[i]);
+    }
+    OS << "],\n\t\t\t\"dependedOnBy\" : ";
+    write_json_names(OS,graph,g.dependedOnBy);
+    if (graph.laid_out)
+      OS << ",\n\t\t\t\"layout\" : [" << format("%.5f",g.at.x)
+	 << ", " << format("%.5f",g.at.y) << "]";
+
+    OS << ",\n\t\t\t\"links\" : [";
+    for (size_t i = 0; i < g.edges.size(); i++) {
+      const graph_edge &edge = g.edges[i];
+      OS << (i ? ",\n\t\t\t\t" : "\n\t\t\t\t") << "{\"source\" : ";
+      write_json_string(OS,graph.nodes[edge.source].name);
+      OS << ", \"strength\" : " << format("%g",edge.strength)
+	 << ", \"width\" : " << format("%g",edge.width)
+	 << ", \"color\" : ";
+      write_json_string(OS,edge.color);
+      OS << "}";
+    }
+    OS << "]\n\t\t}";
+  }
+
+  OS << "\n\t},\n\t\"errors\" : [";
+  for (size_t i = 0; i < graph.errors.size(); i++) {
+    OS << (i ? ",\n\t\t" : "\n\t\t");
+    write_json_string(OS,graph.errors[i]);
+  }
+  OS << "\n\t]\n}\n";
+}
+
+//Write the contents of graph.json
+void write_graph(raw_ostream &OS, const view &v) {
+  stage_timer timer(JSON_STAGE);
+  view_graph graph;
+  build_graph(v,graph);
+  write_json_graph(OS,graph);
+}
+
+//Create graph.json, and objects.bin unless -visualize-binary=false.
+//They are handed to the writer thread once they are made.
+void create_graph_files(string folder, const view &v) {
+  stage_timer timer(JSON_STAGE);
+  view_graph graph;
+  build_graph(v,graph);
+
+  string text;
+  raw_string_ostream File(text);
+  write_json_graph(File,graph);
+  File.flush();
+  write_file(folder + "graph.json",std::move(text),true);
+
+  if (BINARY_GRAPH) {
+    string objects;
+    raw_string_ostream Binary(objects);
+    write_binary_graph(Binary,graph);
+    Binary.flush();
+    write_file(folder + "objects.bin",std::move(objects),true);
+  }
+}
@@ -51,61 +51,113 @@ vector<int> get_config(int nodes) {
 // Graph/node creation related. //
 //////////////////////////////////
 
-//Wrapper to transform node object into json string
-string create_object(node *n) {
-  return create_json_object(n->name,
-			    n->type,
-			    n->group,
-			    n->depends);
+//Look up the name already given to a value. Returns false if it
+//hasn't been named yet
+static bool lookup_name(Value *v, string &name) {
+  sys::SmartScopedReader<true> guard(nameLock);
+  auto it = nameMap.find(v);
+  if (it == nameMap.end() || it->second.size() == 0)
+    return false;
+  name = it->second;
+  return true;
 }
 
-//Standardized format for getting names of things If the value doesn't
-//already have a name, generate a hash for the block contents and let
-//that be the name.
+//Remember the name of a value. If another view named it first, their
+//name wins (it will be the same name anyway)
+static string store_name(Value *v, string name) {
+  sys::SmartScopedWriter<true> guard(nameLock);
+  string &stored = nameMap[v];
+  if (stored.size() == 0)
+    stored = name;
+  return stored;
+}
+
+//The first 16 hex digits of the MD5 of 'key'. That is plenty to
+//tell the values of a function apart, and collisions are resolved by
+//name_function_values anyway.
+static string hash_key(StringRef key) {
+  MD5 Hash;
+  MD5::MD5Result Result;
+  SmallString<32> hash;
+  Hash.update(key);
+  Hash.final(Result);
+  MD5::stringifyResult(Result,hash);
+  return hash.substr(0,16).str();
+}
 
+//Standardized format for getting names of things. If the value doesn't
+//already have a name, it is named after a hash of what it is (see
+//name_function_values), without printing it.
 string get_name(Value *v) {
-  if (nameMap[v].size() > 0)
-    return nameMap[v];
+  string name;
+  if (lookup_name(v,name))
+    return name;
   
   //Try to get LLVM's name
   string obj_name = v->getName();
 
-  // //See if we have already previously given it a name
-  // if (obj_name == "")
-  //   obj_name = nameMap[v];
-
-  //No name? Take a hash of the contents, and that is its name
   if (obj_name == "") {
-    size_t val_hash = hash<string>{}(print(v));
-    string hash_str = to_string(val_hash);
-    
+    //Values in a function are named along with the rest of it, since
+    //their names depend on where they are in it
+    Function *f = nullptr;
+    if (Argument *a = dyn_cast<Argument>(v))
+      f = a->getParent();
+    else if (BasicBlock *b = dyn_cast<BasicBlock>(v))
+      f = b->getParent();
+    else if (Instruction *i = dyn_cast<Instruction>(v))
+      f = i->getParent() ? i->getParent()->getParent() : nullptr;
+    if (f) {
+      name_function_values(*f);
+      if (lookup_name(v,name))
+	return name;
+    }
+
+    //Anything else is named after its kind, its type and, for a global
+    //value, where it is in the module
+    string key;
+    raw_string_ostream OS(key);
+    OS << v->getValueID() << " ";
+    v->getType()->print(OS);
+    if (GlobalValue *g = dyn_cast<GlobalValue>(v)) {
+      Module *m = g->getParent();
+      unsigned index = 0;
+      if (m && isa<Function>(g))
+	for (Function &other : *m) {
+	  if (&other == g) break;
+	  index++;
+	}
+      else if (m)
+	for (GlobalVariable &other : m->globals()) {
+	  if (&other == g) break;
+	  index++;
+	}
+      OS << " @" << index;
+    }
+    OS.flush();
+
     if (isa<Function>(v)) 
-      nameMap[v] = "Fun" + hash_str;
+      obj_name = "Fun" + hash_key(key);
     else if (isa<BasicBlock>(v))
-      nameMap[v] = "Blk" + hash_str;
+      obj_name = "Blk" + hash_key(key);
     else if (isa<Instruction>(v)) 
-      nameMap[v] = "Inst" + hash_str;      
+      obj_name = "Inst" + hash_key(key);
     else 
-      nameMap[v] = "Val" + hash_str;     
-
-    obj_name = nameMap[v];
-
+      obj_name = "Val" + hash_key(key);
   } 
 
-  nameMap[v] = sanitize(obj_name);
-  return nameMap[v];    
+  return store_name(v,sanitize(obj_name));
 }
 
 string get_name(BasicBlock *b) {
-  if (nameMap[b].size() > 0)
-    return nameMap[b];
+  string name;
+  if (lookup_name(b,name))
+    return name;
   
   string obj_name = b->getName();
   if (obj_name == "")
     obj_name = get_name((Value*)b);
   
-  nameMap[b] = sanitize(obj_name);
-  return nameMap[b];    
+  return store_name(b,sanitize(obj_name));
 }
 
 string get_name(Loop *l) {
@@ -117,20 +169,21 @@ string get_name(Loop *l) {
 }
 
 string get_name(Function *f) {
-  if (nameMap[f].size() > 0)
-    return nameMap[f];
+  string name;
+  if (lookup_name(f,name))
+    return name;
 
   string obj_name = f->getName();
   if (obj_name == "")
     obj_name = get_name((Value*)f);
 
-  nameMap[f] = sanitize(obj_name);
-  return nameMap[f];  
+  return store_name(f,sanitize(obj_name));
 }
 
 string get_name(Module *m) {
-  if (nameMap[(Value*)m].size() > 0)
-    return nameMap[(Value*)m];
+  string name;
+  if (lookup_name((Value*)m,name))
+    return name;
 
   //Name the module after the file of the largest function
   string obj_name = "";
@@ -150,8 +203,125 @@ string get_name(Module *m) {
   if (obj_name == "")
     obj_name = get_name((Value*)m);
 
-  nameMap[(Value*)m] = sanitize(obj_name);
-  return nameMap[(Value*)m];
+  return store_name((Value*)m,sanitize(obj_name));
+}
+
+//Name every function, argument, block, instruction and global value
+//used by an instruction
+void name_values(Module &m) {
+  stage_timer timer(NAMING_STAGE);
+  get_name(&m);
+  for (Function &f : m) {
+    get_name(&f);
+    if (f.isDeclaration()) continue;
+    name_function_values(f);
+  }
+}
+
+//What an operand is, for the key of an instruction using it. Unnamed
+//values of the function are known by where they are, so no operand
+//has to be named (or printed) first.
+static void write_operand_key(raw_ostream &OS, Value *op,
+			      const DenseMap<Value*,string> &positions) {
+  if (op->hasName()) {
+    OS << (isa<GlobalValue>(op) ? "@" : "%") << op->getName();
+    return;
+  }
+  auto pos = positions.find(op);
+  if (pos != positions.end())
+    OS << pos->second;
+  else if (ConstantInt *c = dyn_cast<ConstantInt>(op))
+    c->getValue().print(OS,true);
+  else if (ConstantFP *c = dyn_cast<ConstantFP>(op))
+    c->getValueAPF().bitcastToAPInt().print(OS,false);
+  else {
+    OS << "v" << op->getValueID() << ":";
+    op->getType()->print(OS);
+  }
+}
+
+//Name the arguments, blocks and instructions of one function, and the
+//global values it uses. An unnamed value is named after a hash of its
+//function, its place in the function (an instruction by its block and
+//where it is in that block) and what it is: the opcode, type and
+//operands of an instruction. So an instruction keeps its name from one
+//epoch to the next as long as it and the ones before it in its block
+//didn't change. Two values of the function with the same hash get
+//_2, _3... after the name, in the order they are in the function.
+void name_function_values(Function &f) {
+  stage_timer timer(NAMING_STAGE);
+  string fun = get_name(&f);
+
+  //Where every unnamed argument, block and instruction is. Blocks are
+  //numbered, and instructions are numbered within their block
+  DenseMap<Value*,string> positions;
+  unsigned index = 0;
+  for (Argument &a : f.args()) {
+    if (!a.hasName()) positions[&a] = "a" + to_string(index);
+    index++;
+  }
+  index = 0;
+  for (BasicBlock &b : f) {
+    string block = b.hasName() ? "%" + b.getName().str() : "b" + to_string(index);
+    if (!b.hasName()) positions[&b] = block;
+    unsigned inst = 0;
+    for (Instruction &i : b) {
+      if (!i.hasName()) positions[&i] = block + "." + to_string(inst);
+      inst++;
+    }
+    index++;
+  }
+
+  //Give every value its name, unless it already has one
+  StringSet<> used;
+  auto name_value = [&](Value *v, StringRef prefix, const string &key) {
+    string name;
+    if (!lookup_name(v,name)) {
+      if (v->hasName()) {
+	name = sanitize(v->getName().str());
+      } else {
+	string base = prefix.str() + hash_key(key);
+	name = base;
+	for (int n = 2; used.count(name); n++)
+	  name = base + "_" + to_string(n);
+      }
+      name = store_name(v,name);
+    }
+    used.insert(name);
+  };
+
+  for (Argument &a : f.args()) {
+    string key;
+    raw_string_ostream OS(key);
+    OS << fun << " " << positions.lookup(&a) << " ";
+    a.getType()->print(OS);
+    name_value(&a,"Val",OS.str());
+  }
+
+  for (BasicBlock &b : f) {
+    string key;
+    raw_string_ostream OS(key);
+    OS << fun << " " << positions.lookup(&b) << " " << b.size();
+    if (Instruction *t = b.getTerminator())
+      OS << " " << t->getOpcodeName();
+    name_value(&b,"Blk",OS.str());
+
+    for (Instruction &i : b) {
+      string key;
+      raw_string_ostream OS(key);
+      OS << fun << " " << positions.lookup(&i) << " " << i.getOpcodeName() << " ";
+      i.getType()->print(OS);
+      for (Use &op : i.operands()) {
+	OS << " ";
+	write_operand_key(OS,op,positions);
+      }
+      name_value(&i,"Inst",OS.str());
+
+      for (Use &op : i.operands())
+	if (isa<GlobalValue>(op))
+	  get_name(op);
+    }
+  }
 }
 
 
@@ -247,9 +417,9 @@ string change_blocks_to_links(Function *f, string input) {
 
 //Create a helpful/additional function node that summarizes the whol
 //function displayed in this view
-node* create_function_node(Function *f, vector<string> folders, bool links) {
+node* create_function_node(Function *f, vector<string> folders, bool links, view_arena &arena) {
   //Set up the basics
-  node *n = new node(f);  
+  node *n = create_node(arena,f);  
   n->name = get_name(f);
   n->type = "Helper";
   n->group = "";
@@ -258,7 +428,6 @@ node* create_function_node(Function *f, vector<string> folders, bool links) {
 
   vector<string> depends;
   n->depends = depends;  
-  n->json = create_object(n);
 
   //Place at top left
   set_Y_position(n,0,1);
@@ -268,25 +437,27 @@ node* create_function_node(Function *f, vector<string> folders, bool links) {
 }
 
 //Metadata for a loop
-string get_ir(Loop *l) {
+string get_ir(Loop *l, ModuleSlotTracker *MST) {
   if (!ENABLE_IR) return "Disabled";
+  stage_timer timer(IR_STAGE);
   
   string code = "";
   for (BasicBlock *b : l->getBlocks()) 
-    code += print(b);
+    code += print(b,MST);
   
   return prep_metadata(code);
 }
 
 //Metadata for a loop
-string get_debug(Loop *l) {
+string get_debug(Loop *l, ModuleSlotTracker *MST) {
   if (!ENABLE_DEBUG) return "Disabled";
+  stage_timer timer(DEBUG_STAGE);
   Function *parent = l->getBlocks().front()->getParent();
   string debug_header = "File: " + get_file(parent) + "\nDirectory: " + get_dir(parent);
   string debug_content = "";
   
   for (BasicBlock *b : l->getBlocks())
-    debug_content += get_blk_metadata(b);
+    debug_content += get_blk_metadata(b,MST);
   
   return debug_header + "\n" + debug_content;  
 }
@@ -294,14 +465,15 @@ string get_debug(Loop *l) {
 
 //Create helpful/additional loop nodes. These are placed in the top
 //right and corner and are used to access more metadata
-node *create_loop_node(Loop *l, vector<string> folders, bool control_flow) {
+node *create_loop_node(Loop *l, vector<string> folders, bool control_flow, view_arena &arena,
+			ModuleSlotTracker *MST, const hidden_instructions *hidden) {
   //Set up the basics
-  node *n = new node((Value*)l);  
+  node *n = create_node(arena,(Value*)l);  
   n->name = get_name(l);
   n->type = n->name;
   n->group = "";
-  n->metadata = get_ir(l);
-  n->src = get_debug(l);
+  n->metadata = get_ir(l,MST);
+  n->src = get_debug(l,MST);
   string name = n->name;
 
   //Connect the basic blocks this loop with white lines. We don't
@@ -313,7 +485,7 @@ node *create_loop_node(Loop *l, vector<string> folders, bool control_flow) {
     for (BasicBlock *b : l->getBlocks()) {
       depends.push_back(get_name(b));
 
-      node *dep = new node(b);
+      node *dep = create_node(arena,b);
       dep->name = get_name(b);
       set_link_strength(dep,n,0.0);      
       set_link_color(dep,n,"invisible");
@@ -325,11 +497,11 @@ node *create_loop_node(Loop *l, vector<string> folders, bool control_flow) {
     //Link to instructions for data flow views
     for (BasicBlock *b : l->getBlocks()) {
       for (Instruction &i : *b) {
-	if (hide(i)) continue;
+	if (hidden ? hide(i,*hidden) : hide(i)) continue;
 	
 	depends.push_back(get_name(&i));
 
-	node *dep = new node(b);
+	node *dep = create_node(arena,b);
 	dep->name = get_name(&i);
 	set_link_strength(dep,n,0.0);      
 	set_link_color(dep,n,"invisible");
@@ -340,7 +512,6 @@ node *create_loop_node(Loop *l, vector<string> folders, bool control_flow) {
     }
   }
   n->depends = depends;
-  n->json = create_object(n);
 
   //Place at the top left
   set_Y_position(n,0.1,1);
@@ -384,28 +555,76 @@ string get_all_views(vector<string> folders) {
 }
 
 
-//Metadata for a function
-string prep_metadata(string code) {
+//The characters of a metadata reference, such as "!dbg !40"
+static bool is_metadata_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+    (c >= '0' && c <= '9') || c == ' ' || c == '!';
+}
 
-  if (REMOVE_DBG_FROM_IR) {
-    //Remove metadata calls (eg. llvm.dbg.value)
-    regex e(".*llvm.dbg.*\n");
-    code = regex_replace(code,e,"");
-    
-    //Remove additional metadata information (eg. !dbg !40)
-    regex e2 ("![a-zA-Z0-9 !]+");
-    code = regex_replace(code,e2,"");
-  }
+//Does code[from,end) mention llvm.dbg (with any character for the dots)
+static bool is_dbg_line(const string &code, size_t from, size_t end) {
+  for (size_t k = code.find("llvm",from); k != string::npos && k + 8 <= end;
+       k = code.find("llvm",k + 1))
+    if (code.compare(k + 5,3,"dbg") == 0) return true;
+  return false;
+}
 
-  //The markdown script doesn't like <label>, so escape them in this
-  //odd way
-  replaceAll(code,"<label>","label");
-  //  replaceAll(code,"<","\\<"); //This generates a warning :(
-  //replaceAll(code,">","\\>");
+//Metadata for a function. This is one pass over the code that gives
+//the same result the regexes used to:
+//  ".*llvm.dbg.*\n" -> ""		Lines calling llvm.dbg.* are dropped.
+//				'.' doesn't match \r, so only what comes
+//				after a line's last \r is dropped.
+//  "![a-zA-Z0-9 !]+" -> ""	References like !dbg !40 are dropped
+//  "<label>" -> "label"		The markdown script doesn't like <label>
+//  "\n\n" -> "\n<br/>"		Remove some unnecessary space
+string prep_metadata(const string &code) {
+  stage_timer timer(SANITIZE_STAGE);
+  string out;
+  out.reserve(code.size());
+
+  //Replacements don't overlap: a <label> can't start before the end of
+  //the last one, and newlines are paired up, so every second one in a
+  //row becomes a <br/>
+  size_t label_from = 0;
+  bool newline = false;
+  auto emit = [&](char c) {
+    if (c == '\n') {
+      out += newline ? "<br/>" : "\n";
+      newline = !newline;
+      return;
+    }
+    newline = false;
+    if (c == '>' && out.size() >= label_from + 6 &&
+	out.compare(out.size() - 6,6,"<label") == 0) {
+      out.erase(out.size() - 6,1);
+      label_from = out.size();
+      return;
+    }
+    out += c;
+  };
+
+  size_t pos = 0;
+  while (pos < code.size()) {
+    size_t end = code.find('\n',pos);
+    size_t next = end == string::npos ? code.size() : end + 1;
+    size_t stop = next;
+    if (REMOVE_DBG_FROM_IR && end != string::npos) {
+      size_t cr = code.rfind('\r',end);
+      size_t from = (cr == string::npos || cr < pos) ? pos : cr + 1;
+      if (is_dbg_line(code,from,end)) stop = from;
+    }
 
-  //Remove some unncessary space
-  replaceAll(code,"\n\n","\n<br/>");
-  return code;
+    for (size_t i = pos; i < stop; i++) {
+      if (REMOVE_DBG_FROM_IR && code[i] == '!' && i + 1 < stop &&
+	  is_metadata_char(code[i + 1])) {
+	while (i + 1 < stop && is_metadata_char(code[i + 1])) i++;
+	continue;
+      }
+      emit(code[i]);
+    }
+    pos = next;
+  }
+  return out;
 }
 
 //Find what file this function comes from
@@ -447,15 +666,15 @@ string get_dir(Function *f) {
 }
 
 //Get the metadata associated to every instruction in this block
-string get_blk_metadata(BasicBlock *b) {
+string get_blk_metadata(BasicBlock *b, ModuleSlotTracker *MST) {
   string data = get_name(b) + " (" + (string)b->getName() + "):\n";
   for (Instruction &i : *b) {
-    if (i.getMetadata("dbg")) {  
+    if (i.getMetadata(LLVMContext::MD_dbg)) {  
       DebugLoc loc = i.getDebugLoc();
       int line = loc.getLine();
       int col = loc.getCol();
       data += "L" + to_string(line) + ",C" + to_string(col) + ":";
-      data += print(&i) + "\n";
+      data += print(&i,MST) + "\n";
     }
   }
   data += "\n";
@@ -468,53 +687,47 @@ string get_blk_metadata(BasicBlock *b) {
 // Constraint stuff - eventually saved in config.json //
 ////////////////////////////////////////////////////////
 
+//Nodes and constraints are placed in the view's arena
+node *create_node(view_arena &arena, Value *val) {
+  return new (arena.nodes.Allocate()) node(&arena,val);
+}
+
+constraint *create_constraint(node *n, constraint_kind kind) {
+  constraint *c = new (n->arena->constraints.Allocate()) constraint();
+  c->kind = kind;
+  c->source = n;
+  c->target = NULL;
+  c->value = 0;
+  c->weight = 1;
+  n->constraints.push_back(c);
+  return c;
+}
+
 //Set constraints on where the nodes are placed
 void set_Y_position(node *n, float loc, float weight) {
   if (loc < 0 || loc > 1)
     outs() << "Warning location is set beyond graph bounds\n";
-  constraint *c = new constraint();
-  c->name = n->name;
-  c->type = "position";
-  c->X = "y";
-  c->value = to_string(loc);
-  c->Y = "weight";
-  c->weight = to_string(weight);
-  n->constraints.push_back(c);
+  constraint *c = create_constraint(n,POSITION_Y);
+  c->value = loc;
+  c->weight = weight;
 }
 
 //Set constraints on where the nodes are placed
 void set_X_position(node *n, float loc, float weight) {
-  constraint *c = new constraint();
-  c->name = n->name;
-  c->type = "position";
-  c->X = "x";
-  c->value = to_string(loc);
-  c->Y = "weight";
-  c->weight = to_string(weight);
-  n->constraints.push_back(c);
+  constraint *c = create_constraint(n,POSITION_X);
+  c->value = loc;
+  c->weight = weight;
 }
 
 //Set constraints on all a nodes dependency links
 void set_node_strength(node *n, float value) {
-  constraint *c = new constraint();
-  c->name = n->name;
-  c->type = "strength";
-  c->X = "strength";
-  c->value = to_string(value);
-  c->Y = "weight"; //Ignored
-  c->weight = "1.0"; //Ignored
-  n->constraints.push_back(c);
+  constraint *c = create_constraint(n,NODE_STRENGTH);
+  c->value = value;
 }
 
 void set_node_width(node *n, float value) {
-  constraint *c = new constraint();
-  c->name = n->name;
-  c->type = "width";
-  c->X = "width";
-  c->value = to_string(value);
-  c->Y = "weight"; //Ignored
-  c->weight = "1.0"; //Ignored
-  n->constraints.push_back(c);
+  constraint *c = create_constraint(n,NODE_WIDTH);
+  c->value = value;
 }
 
 //Set constraint on the link between two nodes
@@ -523,36 +736,68 @@ void set_link_strength(node *source, node *target, float value) {
     outs() << "Link strength cannot be negative\n";
     return;
   }
-  constraint *c = new constraint();
-  c->name = source->name;
-  c->type = "linkStrength";
-  c->X = "target";
-  c->value = "\"" + target->name + "\"";
-  c->Y = "strength"; 
-  c->weight = to_string(value); 
-  source->constraints.push_back(c);
+  constraint *c = create_constraint(source,LINK_STRENGTH);
+  c->target = target;
+  c->value = value;
 }
 
 void set_link_width(node *source, node *target, float value) {
-  constraint *c = new constraint();
-  c->name = source->name;
-  c->type = "linkWidth";
-  c->X = "target";
-  c->value = "\"" + target->name + "\"";
-  c->Y = "width"; 
-  c->weight = to_string(value); 
-  source->constraints.push_back(c);
+  constraint *c = create_constraint(source,LINK_WIDTH);
+  c->target = target;
+  c->value = value;
 }
 
 void set_link_color(node *source, node *target, string value) {
-  constraint *c = new constraint();
-  c->name = source->name;
-  c->type = "linkColor";
-  c->X = "target";
-  c->value = "\"" + target->name + "\"";
-  c->Y = "color";
-  c->weight = "\"" + value + "\""; 
-  source->constraints.push_back(c);
+  constraint *c = create_constraint(source,LINK_COLOR);
+  c->target = target;
+  c->color = value;
+}
+
+//Turn a constraint into the text fields used in config.json. The
+//numbers are formatted with to_string, as they always have been. The
+//target names and colors of link constraints are left as they are, to
+//be written as json strings.
+void format_constraint(constraint *c, string &type, string &X, string &value,
+		       string &Y, string &weight) {
+  switch (c->kind) {
+  case POSITION_X:
+  case POSITION_Y:
+    type = "position";
+    X = (c->kind == POSITION_X) ? "x" : "y";
+    value = to_string(c->value);
+    Y = "weight";
+    weight = to_string(c->weight);
+    break;
+  case NODE_STRENGTH:
+  case NODE_WIDTH:
+    type = (c->kind == NODE_STRENGTH) ? "strength" : "width";
+    X = type;
+    value = to_string(c->value);
+    Y = "weight"; //Ignored
+    weight = "1.0"; //Ignored
+    break;
+  case LINK_STRENGTH:
+    type = "linkStrength";
+    X = "target";
+    value = c->target->name;
+    Y = "strength";
+    weight = to_string(c->value);
+    break;
+  case LINK_WIDTH:
+    type = "linkWidth";
+    X = "target";
+    value = c->target->name;
+    Y = "width";
+    weight = to_string(c->value);
+    break;
+  case LINK_COLOR:
+    type = "linkColor";
+    X = "target";
+    value = c->target->name;
+    Y = "color";
+    weight = c->color;
+    break;
+  }
 }
 
 
@@ -585,6 +830,25 @@ string format_as_range(vector<int> lines) {
   return lineStr;
 }
 
+//The functions named in hideCallsTo, parsed once. Names are matched
+//whole, so "put" isn't hidden because "puts" is.
+static const StringSet<> &get_hidden_callees() {
+  static const StringSet<> callees = [] {
+    StringSet<> names;
+    SmallVector<StringRef,8> list;
+    StringRef(hideCallsTo).split(list,',',-1,false);
+    for (StringRef name : list)
+      names.insert(name.trim());
+    return names;
+  }();
+  return callees;
+}
+
+//Return true for functions in hideCallsTo, whose calls are hidden
+bool hidden_callee(Function *f) {
+  return f && f->hasName() && get_hidden_callees().count(f->getName());
+}
+
 //Return true for instructions we wish to hide
 bool hide(Value &i) {
   //Hide unconditional branches
@@ -597,12 +861,8 @@ bool hide(Value &i) {
   //Hide calls to hidden functions
   if (CallInst *ci = dyn_cast<CallInst>(&i)) { 
     Value *called = ci->getCalledValue()->stripPointerCasts();
-    Function *called_fun = dyn_cast<Function>(called);
-    if (called_fun && called_fun->hasName()) {
-      string called_name = dyn_cast<Function>(called)->getName();
-      if (hideCallsTo.find(called_name) != string::npos)
-	return true;
-    }
+    if (hidden_callee(dyn_cast<Function>(called)))
+      return true;
   }
 
   //Hide unreachable instructions
@@ -619,34 +879,53 @@ bool hide(Value &i) {
   return false;
 }
 
+//Decide which instructions of 'f' are hidden. A function is usually
+//called many times, so whether a callee is hidden is only looked up
+//once.
+hidden_instructions::hidden_instructions(Function &f) {
+  DenseMap<Value*,bool> callees;
+  for (BasicBlock &b : f) {
+    for (Instruction &i : b) {
+      unsigned number = hidden.size();
+      numbers[&i] = number;
+
+      bool hide_it;
+      if (CallInst *ci = dyn_cast<CallInst>(&i)) {
+	Value *called = ci->getCalledValue()->stripPointerCasts();
+	auto callee = callees.find(called);
+	if (callee == callees.end())
+	  callee = callees.insert(make_pair(called,hidden_callee(dyn_cast<Function>(called)))).first;
+	hide_it = callee->second || i.isUsedByMetadata();
+      } else {
+	hide_it = hide(i);
+      }
+      hidden.push_back(hide_it);
+    }
+  }
+}
+
+//hide(), using the decisions made for the instruction's function.
+//Instructions of other functions are decided on the spot.
+bool hide(Instruction &i, const hidden_instructions &hidden) {
+  auto number = hidden.numbers.find(&i);
+  if (number == hidden.numbers.end())
+    return hide(i);
+  return hidden[number->second];
+}
+
 //The d3 visalization doesn't use curved edges and thus does not
 //support self loops, for this reason we create a dummy object that
-//points back to the original
+//points back to the original. The dummy is written out next to the
+//node in create_objects_file.
 void create_self_loop(node *n) {
-  //Make the dummy dependant on the original, and original on the
-  //dummy
-  vector<string> self_loop_dep;  
-  self_loop_dep.push_back(n->name);
-  n->depends.push_back(n->name+"_SelfLoop");
-
-  //Create the dummy node, and set it as part of this nodes
-  //'object'. This makes the original node actually two nodes
-  string self_loop = create_json_object(n->name+"_SelfLoop",
-					n->type,
-					n->group,
-					self_loop_dep);
-  //  self_loop = self_loop + ",";
-  if (n->json == "")
-    n->json = self_loop;
-  else
-    n->json += "," + self_loop;
+  n->self_loop = true;
 }
 
 //Return true if the specified value is defined in the extracted
 //region.
-bool definedInRegion(vector<BasicBlock *> &Blocks, Value *V) {
+bool definedInRegion(const SmallPtrSetImpl<BasicBlock *> &Blocks, Value *V) {
   if (Instruction *I = dyn_cast<Instruction>(V))
-    if (count(Blocks.begin(),Blocks.end(),I->getParent()) > 0)
+    if (Blocks.count(I->getParent()))
       return true;
   return false;
 }
@@ -655,20 +934,18 @@ bool definedInRegion(vector<BasicBlock *> &Blocks, Value *V) {
 //which nodes are placed at top/bottom. Inputs are defined as a value
 //not defined within the body of the function (function arguments and
 //global values). Outputs are defined as a value with no child users
-//(there is nothing that uses the output)
-void findInputOutputs(Function *f, vector<Value*> &Inputs, vector<Value*> &Outputs) {
-  vector<BasicBlock*> Blocks;
+//(there is nothing that uses the output). Each is found once, in the
+//order they are first used.
+void findInputOutputs(Function *f, const hidden_instructions &hidden,
+		      SetVector<Value*> &Inputs, SetVector<Value*> &Outputs) {
+  SmallPtrSet<BasicBlock*,32> Blocks;
   for (BasicBlock &b : *f)
-    Blocks.push_back(&b);
+    Blocks.insert(&b);
   
+  unsigned number = 0;
   for (BasicBlock &b : *f) {
     for (Instruction &i : b) {
-      if (hide(i)) continue;
-      if (CallInst *ci = dyn_cast<CallInst>(&i)) {
-	Value *called = ci->getCalledValue()->stripPointerCasts();
-	string called_name = dyn_cast<Function>(called)->getName();
-	if (hideCallsTo.find(called_name) != string::npos) continue;
-      }
+      if (hidden[number++]) continue;
       for (Use &op : i.operands()) {
 	if (isa<Function>(op)) continue;
 	if (isa<BasicBlock>(op)) continue;
@@ -677,14 +954,14 @@ void findInputOutputs(Function *f, vector<Value*> &Inputs, vector<Value*> &Outpu
 	if (dyn_cast<Value>(op)->isUsedByMetadata()) continue;
 	if (isa<MetadataAsValue>(op)) continue;
 	if (!definedInRegion(Blocks, op))
-	  Inputs.push_back(op);
+	  Inputs.insert(op);
       }
 
       if (i.user_empty()) {
 	if (isa<BranchInst>(i)) continue;
 	if (isa<UnreachableInst>(i)) continue;
 
-	Outputs.push_back(&i);
+	Outputs.insert(&i);
       }
     }    
   }
@@ -720,37 +997,145 @@ void replaceAll(std::string& str, const std::string& from, const std::string& to
     }
 }
 
+//Intrinsics with metadata operands (eg. llvm.dbg.value) number all of
+//the module's metadata when printed on their own. They keep being
+//printed on their own so their text doesn't change with a tracker.
+static bool references_metadata(Value *v) {
+  CallInst *call = dyn_cast<CallInst>(v);
+  if (!call || !call->getCalledFunction() || !call->getCalledFunction()->isIntrinsic())
+    return false;
+  for (Use &op : call->operands())
+    if (MetadataAsValue *md = dyn_cast_or_null<MetadataAsValue>(op))
+      if (isa<MDNode>(md->getMetadata()))
+	return true;
+  return false;
+}
+
+//A raw_ostream that keeps at most 'limit' characters of what is
+//written to it. Anything past that is dropped as it arrives instead of
+//being stored, and marks the text as trimmed.
+class bounded_ostream : public raw_ostream {
+  string &text;
+  size_t limit;
+  uint64_t pos = 0;
+
+  void write_impl(const char *ptr, size_t size) override {
+    pos += size;
+    if (text.size() < limit)
+      text.append(ptr,min(size,limit - text.size()));
+  }
+  uint64_t current_pos() const override { return pos; }
+
+public:
+  bounded_ostream(string &str, size_t max) : text(str), limit(max) {}
+  ~bounded_ostream() override { flush(); }
+
+  //True if more than 'limit' characters were written
+  bool trimmed() {
+    flush();
+    return pos > limit;
+  }
+};
+
+//Print a block's label and predecessors as LLVM does, then its
+//instructions one at a time, stopping once 'rso' is full
+static void print_block(BasicBlock *b, bounded_ostream &rso, ModuleSlotTracker &MST) {
+  MST.incorporateFunction(*b->getParent());
+  bool entry = b == &b->getParent()->getEntryBlock();
+
+  //The label is the block's operand without the %
+  string label;
+  if (b->hasName() || !entry) {
+    raw_string_ostream L(label);
+    b->printAsOperand(L,false,MST);
+    L.flush();
+    label = label.substr(1) + ":";
+    rso << "\n" << label;
+  }
+  if (!entry) {
+    rso.indent(max<int>(50 - label.size(),1)) << ";";
+    auto first = pred_begin(b), last = pred_end(b);
+    if (first == last)
+      rso << " No predecessors!";
+    else
+      rso << " preds = ";
+    for (auto pred = first; pred != last; ++pred) {
+      if (pred != first) rso << ", ";
+      (*pred)->printAsOperand(rso,false,MST);
+    }
+  }
+  rso << "\n";
+
+  for (Instruction &i : *b) {
+    if (rso.trimmed()) return;
+    i.print(rso,MST);
+    rso << "\n";
+  }
+}
+
+//Print a function's signature and then its blocks, stopping once 'rso'
+//is full. The linkage and attributes are left out.
+static void print_function(Function *f, bounded_ostream &rso, ModuleSlotTracker &MST) {
+  MST.incorporateFunction(*f);
+  rso << "define ";
+  f->getReturnType()->print(rso);
+  rso << " ";
+  f->printAsOperand(rso,false,MST);
+  rso << "(";
+  for (Argument &a : f->args()) {
+    if (a.getArgNo()) rso << ", ";
+    a.printAsOperand(rso,true,MST);
+  }
+  if (f->isVarArg())
+    rso << (f->arg_empty() ? "..." : ", ...");
+  rso << ") {";
+
+  for (BasicBlock &b : *f) {
+    if (rso.trimmed()) return;
+    print_block(&b,rso,MST);
+  }
+  rso << "}\n";
+}
+
  //Returns the print() of an object. This is used in metadata creation
-string print(Value *i)
+string print(Value *i, ModuleSlotTracker *MST)
 {
-  string tmp;
-  
-  raw_string_ostream rso(tmp);
-  i->print(rso);
-  string rso_str = rso.str();
-
-  //Limit the size of print out
-  if (rso_str.size() > MAX_CODE_LENGTH) {
-    rso_str = rso_str.substr(0,MAX_CODE_LENGTH);
+  //Limit the size of print out. Functions and blocks are printed an
+  //instruction at a time and stop once MAX_CODE_LENGTH characters are
+  //kept, for anything else LLVM formats all of it and the rest is
+  //dropped
+  string rso_str;
+  bounded_ostream rso(rso_str,MAX_CODE_LENGTH);
+  Function *f = dyn_cast<Function>(i);
+  BasicBlock *b = dyn_cast<BasicBlock>(i);
+  if ((f && !f->isDeclaration()) || b) {
+    ModuleSlotTracker own(f ? f->getParent() : b->getModule(),false);
+    if (f)
+      print_function(f,rso,MST ? *MST : own);
+    else
+      print_block(b,rso,MST ? *MST : own);
+  } else if (!MST || f || references_metadata(i)) {
+    i->print(rso);
+  } else {
+    //A tracker only knows the function it was last given
+    if (Argument *a = dyn_cast<Argument>(i))
+      MST->incorporateFunction(*a->getParent());
+    i->print(rso,*MST);
+  }
+  if (rso.trimmed())
     rso_str += "\n... (TRIMMED)";
-  }  
-
   return rso_str;
 }
 
 string print(Metadata *m)
 {
-  string tmp;
-  
-  raw_string_ostream rso(tmp);
+  string rso_str;
+  bounded_ostream rso(rso_str,MAX_CODE_LENGTH);
   m->print(rso,nullptr,false);
-  string rso_str = rso.str();
 
   //Limit the size of print out
-  if (rso_str.size() > MAX_CODE_LENGTH) {
-    rso_str = rso_str.substr(0,MAX_CODE_LENGTH);
+  if (rso.trimmed())
     rso_str += "\n... (TRIMMED)";
-  }
 
   return rso_str;
 }
@@ -786,168 +1171,143 @@ int numParents(BasicBlock *b)
   return count;
 }
 
-//Find all the functions that call 'source'
-vector<Function*> find_callers(Function *source)
+//Build the call graph index. Every call site in the module is visited
+//exactly once; callers and callees are recorded in the order they are
+//first seen so the views are laid out the same on every run.
+void build_call_graph(Module &m)
 {
-  vector<Function*> WL;
-  for (Function &f : *source->getParent()) {
+  callGraph = call_graph();
+  for (Function &f : m) {
     for (BasicBlock &b : f) {
       for (Instruction &i : b) {
 	//Only look at callsites
 	CallSite cs(&i);
 	if (!cs.getInstruction()) continue;
+	if (cs.isInlineAsm()) continue;
 	Value *called = cs.getCalledValue()->stripPointerCasts();
+	Function *target = dyn_cast<Function>(called);
 
-	//Check that this function calls the source, and that we
-	//haven't added it to the list already
-	if (dyn_cast<Function>(called) == source &&
-	    find(WL.begin(),WL.end(),&f) == WL.end())
-	  WL.push_back(&f);
+	//Calls through function pointers can't be resolved, count them
+	//separately
+	if (!target) {
+	  callGraph.num_indirect++;
+	  continue;
+	}
+
+	//First call on this edge, link both directions
+	int &calls = callGraph.calls[make_pair(&f,target)];
+	if (calls == 0) {
+	  callGraph.callers[target].push_back(&f);
+	  callGraph.called[&f].push_back(target);
+	  callGraph.num_edges++;
+	}
+	calls++;
       }
     }
   }
-  return WL;
 }
 
-//Find all the functions that 'source' calls
+//Find all the functions that call 'source'
+vector<Function*> find_callers(Function *source)
+{
+  auto it = callGraph.callers.find(source);
+  if (it == callGraph.callers.end())
+    return vector<Function*>();
+  return it->second;
+}
+
+//Find all the function that 'source' calls
 vector<Function*> find_called(Function *source)
 {
   vector<Function*> WL;
-  for (BasicBlock &b : *source) {
-    for (Instruction &i : b) {
-      //Only look at callsites
-      CallSite cs(&i);
-      if (!cs.getInstruction()) continue;
-      Function *called = cs.getCalledFunction();
-      if (!called) {
-	//outs() << "Function pointer found, skipping : " << i << "\n";
-	continue;
-      }
-      if (!SHOW_FUNCTION_DECLARATIONS && called->isDeclaration()) continue;
-      if (find(WL.begin(),WL.end(),source) == WL.end())
-	WL.push_back(called);
-    }
-  } 
+  auto it = callGraph.called.find(source);
+  if (it == callGraph.called.end())
+    return WL;
+  for (Function *called : it->second) {
+    if (!SHOW_FUNCTION_DECLARATIONS && called->isDeclaration()) continue;
+    WL.push_back(called);
+  }
   return WL;
 }
 
 //Count the number of times source calls target
 int count_calls(Function *source, Function *target)
 {
-  int calls = 0;
-  for (BasicBlock &b : *source) {
-    for (Instruction &i : b) {
-      //Only look at callsites
-      CallSite cs(&i);
-      if (!cs.getInstruction()) continue;
-      Function *called = cs.getCalledFunction();
-      if (called == target)
-	calls++;
-    }
-  }
-  
-  return calls;
-} 
+  auto it = callGraph.calls.find(make_pair(source,target));
+  if (it == callGraph.calls.end())
+    return 0;
+  return it->second;
+}
 
 //////////////////////////////////////
 // JSON file writing stuff	    //
-// TODO: use a proper json library  //
 //////////////////////////////////////
 
-//Create a string of objects that constains all the nodes which will
-//be written to file. 
-string create_json_object(string name, string type, string group, vector<string> depends) {
-
-  //Create the object string
-  string name_str_A = "\t\t\"name\" : \"";
-  string name_str_B = "\",";
-  string type_str_A = "\t\t\"type\" : \"";
-  string type_str_B = "\",";  
-  string group_str_A = "\t\t\"group\" : \"";
-  string group_str_B = "\",";
-  string depends_str_A = "\t\t\"depends\" : [";
-  string depends_str_B = "\t\t]";
-  
-  string object = "{\n" +
-    type_str_A + type + type_str_B + "\n" +
-    name_str_A + name + name_str_B + "\n" +
-    group_str_A + group + group_str_B + "\n" +
-    depends_str_A +  "\n";
-
-  //Add all dependencies, and ensure the last comma is handled correctly
-  bool first = true;
-  for (string s : depends) {
-    if (!first)
-      object += ",\n";
-    object += "\t\t\t\"" + s + "\"";
-    first = false;
+//Write a quoted json string, escaping anything json doesn't allow
+void write_json_string(raw_ostream &OS, StringRef str) {
+  OS << '"';
+  for (unsigned char c : str) {
+    switch (c) {
+    case '"':  OS << "\\\""; break;
+    case '\\': OS << "\\\\"; break;
+    case '\n': OS << "\\n"; break;
+    case '\r': OS << "\\r"; break;
+    case '\t': OS << "\\t"; break;
+    case '\b': OS << "\\b"; break;
+    case '\f': OS << "\\f"; break;
+    default:
+      if (c < 0x20)
+	OS << "\\u00" << hexdigit(c >> 4, true) << hexdigit(c & 0xF, true);
+      else
+	OS << c;
+    }
   }
-  object += "\n";
-  object += depends_str_B + "\n";
-
-
+  OS << '"';
+}
 
-  object += "\t}";
-  
-  return object;
+//Write the node types which will be saved in the config file. Each
+//type is only written once.
+void write_config_types(raw_ostream &OS, const vector<node*> &nodes) {
+  StringSet<> seen;
+  for (node *n : nodes) {
+    const string &type_short = n->type;
+    if (!seen.insert(type_short).second) continue;
+    string type_long = "";//n->type_long;
+    if (seen.size() > 1) OS << ",\n";
+    OS << "\t\t"; write_json_string(OS,type_short); OS << " : {\n";
+    OS << "\t\t\t\"short\" : "; write_json_string(OS,type_short); OS << ",\n";
+    OS << "\t\t\t\"long\"  : "; write_json_string(OS,type_long); OS << " \n";
+    OS << "\t\t}";
+  }
 }
 
-//Create objects.json which stores all objects
-void create_objects_file(string folder, vector<node*> nodes ) {
-  fstream File;
-  File.open (folder + "objects.json", fstream::out);
-  File << "[\n";
+//Write the node constraints which will be saved in the config file
+void write_config_constraints(raw_ostream &OS, const vector<node*> &nodes) {
   bool first = true;
   for (node *n : nodes) {
-    if (n->json.size() == 0) continue;
-    if (first) {
-      File << "\t";
+    for (constraint *c : n->constraints) {
+      string type, X, value, Y, weight;
+      format_constraint(c,type,X,value,Y,weight);
+
+      OS << (first ? "\t\t" : ", ");
       first = false;
-    } else {
-      File << ", ";
-    }
-    File << n->json;
-  }
-  File << "\n]\n";
-  File.close();
-}
-
-//Create the node types which will be saved in the config file
-string create_config_types(vector<node*> nodes) {
-  string type_str = "";
-  for (uint i=0;i<nodes.size();i++) {
-    string type_short = nodes[i]->type;
-    //    if (type_short.size() == 0) continue;
-    string type_long = "";//nodes[i]->type_long;
-    if (i>0) type_str += ",\n";
-    type_str += "\t\t\"" + type_short + "\" : {\n"
-      + "\t\t\t\"short\" : \"" + type_short + "\",\n"
-      + "\t\t\t\"long\"  : \"" + type_long  + "\" \n"
-      + "\t\t}";
-  }
-  return type_str;
-}
 
-//Create the node constraints which will be saved in the config file
-string create_config_constraints(vector<node*> nodes) {
-  string constraint_str = "";
-  
-  for (uint i=0;i<nodes.size();i++) {
-    for (uint j=0;j<nodes[i]->constraints.size();j++) {
-      constraint *c = nodes[i]->constraints[j];
-      
-      if (constraint_str != "") constraint_str += ", ";
-      else constraint_str += "\t\t";
-      
-      constraint_str = constraint_str + "{\n"
-	+ "\t\t\t\"has\" : { \"name\" : \"" + c->name + "\" },\n"
-	+ "\t\t\t\"type\" : \"" + c->type + "\",\n"
-	+ "\t\t\t\"" + c->X + "\" : " + c->value + ",\n"
-	+ "\t\t\t\"" + c->Y + "\" : " + c->weight + "\n"
-	+ "\t\t}";
+      OS << "{\n"
+	 << "\t\t\t\"has\" : { \"name\" : "; write_json_string(OS,c->source->name); OS << " },\n"
+	 << "\t\t\t\"type\" : \"" << type << "\",\n"
+	 << "\t\t\t\"" << X << "\" : ";
+      if (c->kind == LINK_STRENGTH || c->kind == LINK_WIDTH || c->kind == LINK_COLOR)
+	write_json_string(OS,value);
+      else
+	OS << value;
+      OS << ",\n\t\t\t\"" << Y << "\" : ";
+      if (c->kind == LINK_COLOR)
+	write_json_string(OS,weight);
+      else
+	OS << weight;
+      OS << "\n\t\t}";
     }
   }
-  return constraint_str;
 }
 
 //Create the configuration file that determines the size of the
@@ -956,17 +1316,24 @@ string create_config_constraints(vector<node*> nodes) {
 void create_config_file(vector<int> config,
 			string folder,
 			string title,
-			vector<node*> nodes) {
+			const vector<node*> &nodes) {
 
-  fstream File;
-  File.open (folder + "config.json", fstream::out);
+  string text;
+  raw_string_ostream File(text);
+  write_config(File,config,title,nodes);
+  File.flush();
+  write_file(folder + "config.json",std::move(text),true);
+}
+
+//Write the contents of config.json
+void write_config(raw_ostream &File, vector<int> config, string title,
+		  const vector<node*> &nodes) {
+  stage_timer timer(JSON_STAGE);
 
   //Start the jsonness
   File << "{\n";
 
-  string title_str_A = "\t\"title\" : \"";
-  string title_str_B = "\",";
-  File << title_str_A << title << title_str_B << "\n";
+  File << "\t\"title\" : "; write_json_string(File,title); File << ",\n";
 
   string graph_str_A = "\t\"graph\" : {";
   string graph_str_B = "\t},";
@@ -990,59 +1357,279 @@ void create_config_file(vector<int> config,
        << "\t\t}\n"
        << graph_str_B << "\n";
 
-  string types_str_A = "\t\"types\" : {";
-  string types_str_B = "\t},";
-  File << types_str_A << "\n"
-       << create_config_types(nodes)
-       << "\n" << types_str_B << "\n";
+  File << "\t\"types\" : {" << "\n";
+  write_config_types(File,nodes);
+  File << "\n" << "\t}," << "\n";
 
-  string constraints_str_A = "\t\"constraints\" : [";
-  string constraints_str_B = "\t]";
-  
-  File << constraints_str_A << "\n"
-       << create_config_constraints(nodes)
-       << constraints_str_B << "\n";
+  File << "\t\"constraints\" : [" << "\n";
+  write_config_constraints(File,nodes);
+  File << "\t]" << "\n";
   
   File << "\n}\n";
-  File.close();
+}
+
+//Write a view's graph.json, config.json and metadata into 'folder'
+data_stats write_view(string folder, view &v) {
+  stage_timer timer(WRITE_STAGE);
+  create_graph_files(folder,v);
+  vector<int> config = get_config(v.nodes.size());
+  create_config_file(config,folder,v.title,v.nodes);
+  return create_data_files(folder,v.nodes);
 }
 
 //  Create the metadata files, one for each node. Saved into the
 //  folder of that view with the filename of <object_name>.mkdn. This
-//  file supports markdown formatting and javascript
-void create_data_files(string folder, vector<node*> nodes) {
-  fstream File;
+//  file supports markdown formatting and javascript. Nothing is
+//  written if the nodes have no texts.
+data_stats create_data_files(string folder, vector<node*> nodes) {
+  if (!writes_node_texts())
+    return data_stats();
+  if (STORE_DATA_OBJECTS)
+    return create_object_data_files(folder,nodes);
+  if (PACK_DATA_FILES)
+    return create_packed_data_files(folder,nodes);
+
+  data_stats stats;
+  last_epoch_view last;
+  bool do_diff = ENABLE_DIFF && open_last_epoch(folder,last);
+
+  //The files are written by the writer thread
   for (node *n : nodes) {
 
-    //First metadown file (IR)
+    //First metadown file (IR). It isn't compressed, the next epoch
+    //diffs against it
     string obj_name = n->name;
-    string filename = folder + obj_name + ".mkdn";
-    File.open (filename, fstream::out);
-    File << n->metadata;
-    File.close();
+    write_file(folder + obj_name + ".mkdn",n->metadata);
 
     //Second metadata file (Source)
-    string src_filename = folder + obj_name + ".src.mkdn";
-    File.open (src_filename, fstream::out);
-    File << n->src;
-    File.close();
+    write_file(folder + obj_name + ".src.mkdn",n->src,true);
 
     //Third metadata file (Diff), find the diff between the last epoch
     //and this one
-    if (ENABLE_DIFF && current_epoch > 0) {
-      int this_epoch = current_epoch;
-      int last_epoch = current_epoch - 1;
-      
-      string this_epoch_file = filename;
-      string last_epoch_file = "/var/www/html/" +folder + obj_name + ".mkdn";
-      replaceAll(last_epoch_file,"epoch" + to_string(this_epoch), "epoch" + to_string(last_epoch));
+    if (do_diff)
+      write_file(folder + obj_name + ".diff.mkdn",diff_last_epoch(last,n,stats),true);
+  }
+  return stats;
+}
 
-      string diff_command = "diff  " + last_epoch_file + " " + this_epoch_file + " > " + folder + obj_name + ".diff.mkdn 2> /dev/null";
-      //string diff_command = "ls -alsh > " + folder + obj_name + ".diff.mkdn";
+//Diff a node's IR against the last epoch, counting it in 'stats'
+string diff_last_epoch(last_epoch_view &last, node *n, data_stats &stats) {
+  stage_timer timer(DIFF_STAGE);
+  auto start = chrono::steady_clock::now();
+  string before, diff;
+  if (read_last_epoch(last,n->name,before)) {
+    diff = diff_lines(before,n->metadata);
+    if (!diff.empty()) stats.changed++;
+  } else {
+    stats.added++;
+  }
+  stats.ms += chrono::duration<double,milli>(chrono::steady_clock::now() - start).count();
+  return diff;
+}
+
+//  Create the packed metadata for a view. Every node's texts are
+//  concatenated into data.pack, and data.index holds their offsets.
+data_stats create_packed_data_files(string folder, vector<node*> nodes) {
+  data_stats stats;
+  string pack, index;
+  raw_string_ostream Pack(pack), Index(index);
 
+  last_epoch_view last;
+  bool do_diff = ENABLE_DIFF && open_last_epoch(folder,last);
 
-      system(diff_command.c_str());
+  for (node *n : nodes) {
+    string texts[NUM_DATA_KINDS];
+    texts[IR_DATA] = n->metadata;
+    texts[SRC_DATA] = n->src;
+    if (do_diff)
+      texts[DIFF_DATA] = diff_last_epoch(last,n,stats);
+
+    Index << n->name;
+    for (int kind = 0; kind < NUM_DATA_KINDS; kind++) {
+      Index << "\t" << Pack.tell() << "\t" << texts[kind].size();
+      Pack << texts[kind];
     }
+    Index << "\n";
   }
+  Pack.flush();
+  Index.flush();
+  write_file(folder + "data.pack",std::move(pack));
+  write_file(folder + "data.index",std::move(index));
+  return stats;
 }
 
+//Read data.index of a packed view. Returns false if the view isn't packed
+bool read_pack_index(string folder, pack_index &index) {
+  auto buffer = MemoryBuffer::getFile(folder + "data.index");
+  if (!buffer)
+    return false;
+
+  SmallVector<StringRef,16> lines, fields;
+  (*buffer)->getBuffer().split(lines,'\n',-1,false);
+  for (StringRef line : lines) {
+    fields.clear();
+    line.split(fields,'\t');
+    if (fields.size() != 1 + 2 * NUM_DATA_KINDS) continue;
+
+    pack_entry &entry = index[fields[0].str()];
+    for (int kind = 0; kind < NUM_DATA_KINDS; kind++) {
+      fields[1 + 2 * kind].getAsInteger(10,entry.offset[kind]);
+      fields[2 + 2 * kind].getAsInteger(10,entry.length[kind]);
+    }
+  }
+  return true;
+}
+
+//  Create the metadata of a view in the object store. Texts that are
+//  the same as in any earlier epoch (or another view) are already
+//  there, so only what changed gets written.
+data_stats create_object_data_files(string folder, vector<node*> nodes) {
+  data_stats stats;
+  string refs;
+  raw_string_ostream Refs(refs);
+
+  last_epoch_view last;
+  bool do_diff = ENABLE_DIFF && open_last_epoch(folder,last);
+
+  for (node *n : nodes) {
+    string texts[NUM_DATA_KINDS];
+    texts[IR_DATA] = n->metadata;
+    texts[SRC_DATA] = n->src;
+    if (do_diff)
+      texts[DIFF_DATA] = diff_last_epoch(last,n,stats);
+
+    Refs << n->name;
+    for (int kind = 0; kind < NUM_DATA_KINDS; kind++)
+      Refs << "\t" << store_object(texts[kind],stats);
+    Refs << "\n";
+  }
+  Refs.flush();
+  write_file(folder + "data.refs",std::move(refs));
+  return stats;
+}
+
+//Where the object with this hash is kept. The first two digits of the
+//hash are a folder, so no one folder gets too big
+string object_path(StringRef hash) {
+  return dataRoot + "objects/" + hash.substr(0,2).str() + "/" + hash.substr(2).str();
+}
+
+//Save 'text' in the object store if it isn't already there, and
+//return its hash. An object is written to a temporary file and then
+//renamed, so views written in parallel never see half an object.
+string store_object(StringRef text, data_stats &stats) {
+  MD5 Hash;
+  MD5::MD5Result Result;
+  SmallString<32> hash;
+  Hash.update(text);
+  Hash.final(Result);
+  MD5::stringifyResult(Result,hash);
+
+  string path = object_path(hash);
+  if (sys::fs::exists(path)) {
+    stats.reused++;
+    if (publishing()) publish_object(path);
+    return hash.str();
+  }
+
+  int FD;
+  SmallString<128> tmp_path;
+  //Readable by all (less the umask), as objects are published to the
+  //web server
+  sys::fs::create_directories(sys::path::parent_path(path),true,sys::fs::all_all);
+  if (error_code EC = sys::fs::createUniqueFile(path + "-%%%%%%.tmp", FD, tmp_path)) {
+    errs() << "Unable to write " << path << ": " << EC.message() << "\n";
+    return hash.str();
+  }
+  {
+    raw_fd_ostream File(FD,true);
+    File << text;
+  }
+  sys::fs::rename(tmp_path,path);
+  stats.stored++;
+  stats.stored_bytes += text.size();
+  count_written(text.size());
+  if (publishing()) publish_object(path);
+  return hash.str();
+}
+
+//Read data.refs of a view in the object store. Returns false if the
+//view isn't in the store
+bool read_ref_index(string folder, ref_index &index) {
+  auto buffer = MemoryBuffer::getFile(folder + "data.refs");
+  if (!buffer)
+    return false;
+
+  SmallVector<StringRef,16> lines, fields;
+  (*buffer)->getBuffer().split(lines,'\n',-1,false);
+  for (StringRef line : lines) {
+    fields.clear();
+    line.split(fields,'\t');
+    if (fields.size() != 1 + NUM_DATA_KINDS) continue;
+
+    array<string,NUM_DATA_KINDS> &hashes = index[fields[0].str()];
+    for (int kind = 0; kind < NUM_DATA_KINDS; kind++)
+      hashes[kind] = fields[1 + kind].str();
+  }
+  return true;
+}
+
+//The folder of the same view in the last epoch, or "" if this is the
+//first epoch. Epochs sit side by side in the data folder, so this is
+//the same path with the epoch before.
+string last_epoch_folder(string folder) {
+  if (current_epoch <= 0) return "";
+  string this_epoch = dataRoot + "epoch" + to_string(current_epoch) + "/";
+  if (folder.compare(0,this_epoch.size(),this_epoch) != 0) return "";
+  return dataRoot + "epoch" + to_string(current_epoch - 1) + "/"
+    + folder.substr(this_epoch.size());
+}
+
+//Find the last epoch of the view in 'folder'. The last epoch may have
+//been packed, in the object store, neither, or reused from an even
+//earlier epoch.
+bool open_last_epoch(string folder, last_epoch_view &last) {
+  last.folder = last_epoch_folder(folder);
+  if (last.folder.empty()) return false;
+  last.folder = resolve_view_folder(last.folder);
+
+  //A packed view is read from memory, the index and pack are only
+  //loaded once
+  if (read_pack_index(last.folder,last.index)) {
+    auto buffer = MemoryBuffer::getFile(last.folder + "data.pack");
+    if (buffer) last.pack = std::move(*buffer);
+    last.packed = true;
+  } else if (read_ref_index(last.folder,last.refs)) {
+    last.stored = true;
+  }
+  return true;
+}
+
+//Read a node's IR from the last epoch. Returns false if the node
+//wasn't there
+bool read_last_epoch(last_epoch_view &last, const string &name, string &text) {
+  if (last.stored) {
+    auto entry = last.refs.find(name);
+    if (entry == last.refs.end()) return false;
+    auto buffer = MemoryBuffer::getFile(object_path(entry->second[IR_DATA]));
+    if (!buffer) return false;
+    text = (*buffer)->getBuffer().str();
+    return true;
+  }
+
+  if (!last.packed) {
+    auto buffer = MemoryBuffer::getFile(last.folder + name + ".mkdn");
+    if (!buffer) return false;
+    text = (*buffer)->getBuffer().str();
+    return true;
+  }
+
+  auto entry = last.index.find(name);
+  if (!last.pack || entry == last.index.end()) return false;
+  StringRef pack = last.pack->getBuffer();
+  uint64_t offset = entry->second.offset[IR_DATA];
+  uint64_t length = entry->second.length[IR_DATA];
+  if (offset + length > pack.size()) return false;
+  text = pack.substr(offset,length).str();
+  return true;
+}
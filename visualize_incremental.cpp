@@ -0,0 +1,162 @@
+#include "visualize.hpp"
+
+//////////////////////////////////////////////////////////////////
+// Incremental epochs - A function that hasn't changed since the //
+// last epoch points at that epoch's views instead of rebuilding //
+//////////////////////////////////////////////////////////////////
+
+//How many function views were reused and rebuilt this epoch
+atomic<unsigned> viewsReused(0), viewsRebuilt(0);
+
+//The IR hash of every function, filled in by hash_functions before
+//any view is made
+static DenseMap<Function*,string> irHashes;
+
+//A raw_ostream that hashes what is written to it instead of keeping
+//it, so a function can be fingerprinted without printing it to a string
+class hashing_ostream : public raw_ostream {
+  MD5 Hash;
+  uint64_t pos = 0;
+
+  void write_impl(const char *ptr, size_t size) override {
+    Hash.update(StringRef(ptr,size));
+    pos += size;
+  }
+  uint64_t current_pos() const override { return pos; }
+
+public:
+  ~hashing_ostream() override { flush(); }
+
+  //The hash of everything written so far, as hex
+  string result() {
+    flush();
+    MD5::MD5Result Result;
+    SmallString<32> hex;
+    Hash.final(Result);
+    MD5::stringifyResult(Result,hex);
+    return hex.str();
+  }
+};
+
+//Hash the IR of every function in the module. A function using
+//another one only needs its hash, not another print of it.
+void hash_functions(Module &m) {
+  irHashes.clear();
+  for (Function &f : m) {
+    hashing_ostream OS;
+    f.print(OS);
+    irHashes[&f] = OS.result();
+  }
+}
+
+//The settings that change what is written into a function's views
+static void write_settings(raw_ostream &OS) {
+  OS << ENABLE_IR << ENABLE_DEBUG << ENABLE_DIFF << REMOVE_DBG_FROM_IR
+     << PACK_DATA_FILES << STORE_DATA_OBJECTS << MAX_CODE_LENGTH
+     << CONNECT_GLOBAL_VALUES << SHOW_INSTRUCTION_TYPE
+     << SHOW_INSTRUCTION_GROUP << SHOW_INSTRUCTION_LOOP << GROUP_DF_BY_CF
+     << BINARY_GRAPH << COMPRESSION << LAYOUT_NODES
+     << "\n" << hideCallsTo << "\n" << root_address << "\n"
+     << GRAPH_FORMAT << "\n";
+}
+
+//Fingerprint everything that goes into the views of 'f': its IR, the
+//globals it uses, its loop numbers, its debug locations and the
+//settings. A function with the same fingerprint as in the last epoch
+//has the same views.
+string get_fingerprint(Function &f, LoopInfo *LI) {
+  hashing_ostream OS;
+  write_settings(OS);
+  OS << get_name(&f) << "\n" << irHashes[&f] << "\n"
+     << get_file(&f) << "\n" << get_dir(&f) << "\n";
+
+  //Loop numbers are counted over the whole module, so they can change
+  //when another function does. Debug locations aren't in the printed
+  //IR, only references to them are.
+  SmallPtrSet<GlobalValue*,16> globals;
+  for (BasicBlock &b : f) {
+    if (Loop *l = LI->getLoopFor(&b))
+      OS << get_name(l);
+    OS << "\n";
+
+    for (Instruction &i : b) {
+      if (i.getMetadata(LLVMContext::MD_dbg)) {
+	DebugLoc loc = i.getDebugLoc();
+	OS << loc.getLine() << ":" << loc.getCol() << " ";
+      }
+
+      //Globals used by the function are nodes of its data flow view
+      for (Use &u : i.operands()) {
+	GlobalValue *g = dyn_cast<GlobalValue>(u);
+	if (!g || !globals.insert(g).second) continue;
+	if (Function *callee = dyn_cast<Function>(g))
+	  OS << irHashes[callee] << "\n";
+	else
+	  g->print(OS);
+      }
+    }
+  }
+  return OS.result();
+}
+
+//The folder a view's files are really in. A reused view only holds
+//origin.txt, naming the folder (within dataRoot) of the view it reuses
+string resolve_view_folder(string folder) {
+  auto origin = MemoryBuffer::getFile(folder + "origin.txt");
+  if (!origin)
+    return folder;
+  return dataRoot + (*origin)->getBuffer().trim().str() + "/";
+}
+
+//Write a small text file, such as fingerprint.txt
+static bool write_text_file(string filename, StringRef text) {
+  error_code EC;
+  raw_fd_ostream File(filename, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << "Unable to write " << filename << ": " << EC.message() << "\n";
+    return false;
+  }
+  File << text << "\n";
+  return true;
+}
+
+//Write fingerprint.txt once the files of the view in 'folder' are
+//written, by the writer thread. It is left out if any of them couldn't
+//be, so the next epoch never reuses a view that isn't all there.
+static void queue_fingerprint(string folder, string fingerprint) {
+  after_writes([folder,fingerprint] {
+      if (folder_written(folder))
+	write_text_file(folder + "fingerprint.txt",fingerprint);
+      else
+	errs() << "Not saving the fingerprint of " << folder << ", its files weren't all written\n";
+    });
+}
+
+//Save the fingerprint of a view that was just built, once its files
+//are written
+void write_fingerprint(string folder, const string &fingerprint) {
+  queue_fingerprint(folder,fingerprint);
+  viewsRebuilt++;
+}
+
+//Reuse the last epoch's view if it was made from the same fingerprint,
+//by writing origin.txt into 'folder'. Returns false if the view has to
+//be built.
+bool reuse_view(string folder, const string &fingerprint) {
+  string last_folder = last_epoch_folder(folder);
+  if (last_folder.empty())
+    return false;
+
+  auto last = MemoryBuffer::getFile(last_folder + "fingerprint.txt");
+  if (!last || (*last)->getBuffer().trim() != fingerprint)
+    return false;
+
+  //Point straight at where the files are, so there are never chains
+  //of origins to follow
+  string origin = resolve_view_folder(last_folder);
+  origin = origin.substr(dataRoot.size(), origin.size() - dataRoot.size() - 1);
+  write_file(folder + "origin.txt",origin + "\n");
+  queue_fingerprint(folder,fingerprint);
+  viewsReused++;
+  return true;
+}
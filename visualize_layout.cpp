@@ -0,0 +1,303 @@
+#include "visualize.hpp"
+#include <algorithm>
+#include <cmath>
+
+//////////////////////////////////////////////////////////////////
+// Layout - Places the nodes of large views in the pass, so the	//
+// browser only has to draw them instead of running d3's force	//
+// simulation over thousands of nodes.			//
+//////////////////////////////////////////////////////////////////
+
+//Barycenter sweeps (down then up) ordering the nodes of each layer
+#define LAYOUT_SWEEPS 8
+
+//Steps of the force layout, and how far a node may move in the first
+//one. The step shrinks to nothing by the last
+#define LAYOUT_ITERATIONS 100
+#define LAYOUT_START_STEP 0.05f
+
+//Barnes-Hut: a cell of the quadtree narrower than this times its
+//distance pushes as one body
+#define LAYOUT_THETA 1.2f
+
+//Cells of this many nodes or fewer aren't split, and push node by node.
+//Nor are cells past the depth, so nodes in the same spot don't split
+//them forever
+#define LAYOUT_LEAF_NODES 8
+#define LAYOUT_MAX_DEPTH 24
+
+//Break the cycles of a graph with a depth first search from its roots
+//(nodes nothing points to, then any left), leaving out the edges back
+//to a node on the search's stack. For control flow these are the loop
+//back edges, so blocks end up below the blocks that dominate them.
+//Returns the nodes in topological order, and the edges kept in 'down'.
+static vector<uint32_t> break_cycles(const vector<vector<uint32_t>> &sources,
+				     vector<vector<uint32_t>> &down) {
+  uint32_t n = sources.size();
+  vector<vector<uint32_t>> targets(n);
+  for (uint32_t t = 0; t < n; t++)
+    for (uint32_t s : sources[t])
+      targets[s].push_back(t);
+
+  enum { NEW, ON_STACK, DONE };
+  vector<char> state(n,NEW);
+  vector<uint32_t> postorder;
+  postorder.reserve(n);
+  down.assign(n,vector<uint32_t>());
+
+  vector<pair<uint32_t,uint32_t>> stack; //Node and its next target
+  auto search = [&](uint32_t root) {
+    stack.push_back(make_pair(root,0));
+    state[root] = ON_STACK;
+    while (!stack.empty()) {
+      uint32_t v = stack.back().first;
+      uint32_t &next = stack.back().second;
+      if (next == targets[v].size()) {
+	state[v] = DONE;
+	postorder.push_back(v);
+	stack.pop_back();
+	continue;
+      }
+      uint32_t t = targets[v][next++];
+      if (state[t] == ON_STACK)
+	continue; //A back edge
+      down[v].push_back(t);
+      if (state[t] == NEW) {
+	state[t] = ON_STACK;
+	stack.push_back(make_pair(t,0));
+      }
+    }
+  };
+  for (uint32_t v = 0; v < n; v++)
+    if (sources[v].empty() && state[v] == NEW)
+      search(v);
+  for (uint32_t v = 0; v < n; v++)
+    if (state[v] == NEW)
+      search(v);
+
+  reverse(postorder.begin(),postorder.end());
+  return postorder;
+}
+
+//Pull each node towards its anchor by the anchor's weight, all the way
+//for weights of 1 or more
+static void pull_to_anchors(vector<layout_point> &points, const vector<layout_anchor> &anchors) {
+  for (size_t v = 0; v < points.size(); v++) {
+    const layout_anchor &a = anchors[v];
+    layout_point &p = points[v];
+    if (a.x_weight > 0) p.x += (a.x - p.x) * min(a.x_weight,1.0f);
+    if (a.y_weight > 0) p.y += (a.y - p.y) * min(a.y_weight,1.0f);
+  }
+}
+
+//Lay out a graph in layers (Sugiyama style). Each node's layer is the
+//longest path to it once the cycles are broken, and the nodes of each
+//layer are ordered by the average place of their neighbours to cut
+//down on crossings. Anchored nodes are then moved to their anchors.
+vector<layout_point> layered_layout(const vector<vector<uint32_t>> &sources,
+				    const vector<layout_anchor> &anchors) {
+  uint32_t n = sources.size();
+  vector<layout_point> points(n);
+  if (n == 0) return points;
+
+  vector<vector<uint32_t>> down;
+  vector<uint32_t> order = break_cycles(sources,down);
+
+  vector<uint32_t> rank(n,0);
+  uint32_t ranks = 1;
+  for (uint32_t v : order)
+    for (uint32_t t : down[v]) {
+      rank[t] = max(rank[t],rank[v] + 1);
+      ranks = max(ranks,rank[t] + 1);
+    }
+
+  vector<vector<uint32_t>> up(n);
+  for (uint32_t v = 0; v < n; v++)
+    for (uint32_t t : down[v])
+      up[t].push_back(v);
+
+  //Layers start in topological order. 'place' is where a node is
+  //across its layer, from 0 to 1, so layers of any width compare
+  vector<vector<uint32_t>> layers(ranks);
+  for (uint32_t v : order)
+    layers[rank[v]].push_back(v);
+  vector<float> place(n);
+  auto set_places = [&](const vector<uint32_t> &layer) {
+    for (size_t i = 0; i < layer.size(); i++)
+      place[layer[i]] = (i + 0.5f) / layer.size();
+  };
+  for (auto &layer : layers)
+    set_places(layer);
+
+  vector<float> barycenter(n);
+  auto sweep = [&](vector<uint32_t> &layer, const vector<vector<uint32_t>> &neighbours) {
+    for (uint32_t v : layer) {
+      if (neighbours[v].empty()) {
+	barycenter[v] = place[v];
+	continue;
+      }
+      float sum = 0;
+      for (uint32_t u : neighbours[v])
+	sum += place[u];
+      barycenter[v] = sum / neighbours[v].size();
+    }
+    stable_sort(layer.begin(),layer.end(),[&](uint32_t a, uint32_t b) {
+      return barycenter[a] < barycenter[b];
+    });
+    set_places(layer);
+  };
+  for (int i = 0; i < LAYOUT_SWEEPS; i++) {
+    for (uint32_t r = 1; r < ranks; r++)
+      sweep(layers[r],up);
+    for (uint32_t r = ranks - 1; r-- > 0;)
+      sweep(layers[r],down);
+  }
+
+  for (uint32_t v = 0; v < n; v++) {
+    points[v].x = place[v];
+    points[v].y = (rank[v] + 0.5f) / ranks;
+  }
+  pull_to_anchors(points,anchors);
+  return points;
+}
+
+//A cell of the Barnes-Hut quadtree: how many nodes are in it, their
+//center, where they start in the tree's nodes, and the cells it is
+//split into (0 if none)
+struct quad_cell {
+  float x, y;
+  uint32_t count, first;
+  uint32_t children[4];
+};
+
+struct quadtree {
+  vector<quad_cell> cells;
+  const vector<layout_point> *points;
+  const uint32_t *nodes;
+
+  //Build the cell of 'nodes' (which it reorders) inside the square at
+  //x0,y0 of width 'size'. Returns its index
+  uint32_t build(uint32_t *begin, uint32_t *end, float x0, float y0, float size, int depth) {
+    uint32_t index = cells.size();
+    cells.push_back(quad_cell());
+    quad_cell cell = {0, 0, (uint32_t)(end - begin), (uint32_t)(begin - nodes), {0, 0, 0, 0}};
+    for (uint32_t *v = begin; v != end; v++) {
+      cell.x += (*points)[*v].x;
+      cell.y += (*points)[*v].y;
+    }
+    cell.x /= cell.count;
+    cell.y /= cell.count;
+
+    if (cell.count > LAYOUT_LEAF_NODES && depth < LAYOUT_MAX_DEPTH) {
+      float half = size / 2, mx = x0 + half, my = y0 + half;
+      const vector<layout_point> &p = *points;
+      uint32_t *ysplit = partition(begin,end,[&](uint32_t v) { return p[v].y < my; });
+      uint32_t *top = partition(begin,ysplit,[&](uint32_t v) { return p[v].x < mx; });
+      uint32_t *bottom = partition(ysplit,end,[&](uint32_t v) { return p[v].x < mx; });
+      uint32_t *bounds[5] = {begin, top, ysplit, bottom, end};
+      for (int q = 0; q < 4; q++)
+	if (bounds[q] != bounds[q + 1])
+	  cell.children[q] = build(bounds[q],bounds[q + 1],x0 + (q & 1) * half,
+				   y0 + (q >> 1) * half,half,depth + 1);
+    }
+    cells[index] = cell;
+    return index;
+  }
+
+  //Add the push of every node on the point at x,y to fx,fy, where two
+  //nodes 'd' apart push with k^2 / d
+  void push(uint32_t index, float size, float x, float y, float k2, float &fx, float &fy) const {
+    const quad_cell &cell = cells[index];
+    float dx = x - cell.x, dy = y - cell.y;
+    float d2 = dx * dx + dy * dy;
+    if (size * size < LAYOUT_THETA * LAYOUT_THETA * d2) {
+      float f = k2 * cell.count / d2;
+      fx += dx * f;
+      fy += dy * f;
+      return;
+    }
+    if (!(cell.children[0] | cell.children[1] | cell.children[2] | cell.children[3])) {
+      const vector<layout_point> &p = *points;
+      for (uint32_t i = cell.first; i < cell.first + cell.count; i++) {
+	float nx = x - p[nodes[i]].x, ny = y - p[nodes[i]].y;
+	float nd2 = nx * nx + ny * ny;
+	if (nd2 < 1e-12f) continue; //The point itself, or one on top of it
+	fx += nx * k2 / nd2;
+	fy += ny * k2 / nd2;
+      }
+      return;
+    }
+    for (uint32_t child : cell.children)
+      if (child)
+	push(child,size / 2,x,y,k2,fx,fy);
+  }
+};
+
+//Lay out a graph with forces (Fruchterman-Reingold, with Barnes-Hut
+//for the pushes between all nodes), starting from the layered layout.
+//Edges pull their nodes together, and nodes are pulled towards their
+//anchors by the anchors' weights.
+vector<layout_point> force_layout(const vector<vector<uint32_t>> &sources,
+				  const vector<layout_anchor> &anchors) {
+  vector<layout_point> points = layered_layout(sources,anchors);
+  uint32_t n = points.size();
+  if (n < 2) return points;
+
+  //The ideal distance between nodes, with all of them in the unit square
+  float k = sqrt(1.0f / n), k2 = k * k;
+  vector<uint32_t> nodes(n);
+  vector<float> fx(n), fy(n);
+  for (int i = 0; i < LAYOUT_ITERATIONS; i++) {
+    float step = LAYOUT_START_STEP * (1 - (float)i / LAYOUT_ITERATIONS);
+
+    float x0 = points[0].x, y0 = points[0].y, x1 = x0, y1 = y0;
+    for (uint32_t v = 0; v < n; v++) {
+      nodes[v] = v;
+      x0 = min(x0,points[v].x); x1 = max(x1,points[v].x);
+      y0 = min(y0,points[v].y); y1 = max(y1,points[v].y);
+    }
+    float size = max(max(x1 - x0,y1 - y0),1e-6f);
+    quadtree tree;
+    tree.points = &points;
+    tree.nodes = nodes.data();
+    tree.cells.reserve(n);
+    tree.build(nodes.data(),nodes.data() + n,x0,y0,size,0);
+
+    for (uint32_t v = 0; v < n; v++) {
+      fx[v] = fy[v] = 0;
+      tree.push(0,size,points[v].x,points[v].y,k2,fx[v],fy[v]);
+    }
+    for (uint32_t t = 0; t < n; t++)
+      for (uint32_t s : sources[t]) {
+	float dx = points[t].x - points[s].x, dy = points[t].y - points[s].y;
+	float d = sqrt(dx * dx + dy * dy);
+	fx[t] -= dx * d / k; fy[t] -= dy * d / k;
+	fx[s] += dx * d / k; fy[s] += dy * d / k;
+      }
+
+    for (uint32_t v = 0; v < n; v++) {
+      float f = sqrt(fx[v] * fx[v] + fy[v] * fy[v]);
+      if (f > step) {
+	fx[v] *= step / f;
+	fy[v] *= step / f;
+      }
+      points[v].x += fx[v];
+      points[v].y += fy[v];
+    }
+    pull_to_anchors(points,anchors);
+  }
+
+  //Stretch the layout over the whole graph area, then put the anchored
+  //nodes back where their constraints say
+  float x0 = points[0].x, y0 = points[0].y, x1 = x0, y1 = y0;
+  for (const layout_point &p : points) {
+    x0 = min(x0,p.x); x1 = max(x1,p.x);
+    y0 = min(y0,p.y); y1 = max(y1,p.y);
+  }
+  for (layout_point &p : points) {
+    p.x = x1 > x0 ? (p.x - x0) / (x1 - x0) : 0.5f;
+    p.y = y1 > y0 ? (p.y - y0) / (y1 - y0) : 0.5f;
+  }
+  pull_to_anchors(points,anchors);
+  return points;
+}
@@ -0,0 +1,117 @@
+#include "visualize.hpp"
+#include "llvm/Support/Compression.h"
+
+//////////////////////////////////////////////////////////////////
+// Options - The settings of visualize.so, given to opt on the	//
+// command line (or in a response file, eg. opt @visualize.rsp) //
+//////////////////////////////////////////////////////////////////
+
+static cl::OptionCategory VisualizeCategory("LLVMVis options");
+
+//How much detail goes into each node. A setting given on its own
+//overrides the profile
+cl::opt<detail_profile> PROFILE("visualize-profile",
+  cl::desc("How much detail to write for each node"),
+  cl::values(clEnumValN(SKELETON,"skeleton","Only the graphs, no IR, debug info or diffs"),
+	     clEnumValN(STANDARD,"standard","The graphs, IR and diffs, no debug info"),
+	     clEnumValN(FULL,"full","Everything (default)")),
+  cl::init(FULL), cl::cat(VisualizeCategory));
+
+/* General view settings */
+cl::opt<bool> DO_SYNC("visualize-sync", cl::init(true), cl::cat(VisualizeCategory),
+  cl::desc("Publish the views to the web folder"));
+cl::opt<bool> VERBOSE("visualize-verbose", cl::init(true), cl::cat(VisualizeCategory),
+  cl::desc("Print progress"));
+cl::opt<bool> REMOVE_DBG_FROM_IR("visualize-strip-dbg", cl::init(true), cl::cat(VisualizeCategory),
+  cl::desc("Leave llvm.dbg calls and !metadata out of the IR shown"));
+cl::opt<bool> ENABLE_IR("visualize-ir", cl::init(true), cl::cat(VisualizeCategory),
+  cl::desc("Write each node's IR (+4x slow down)"));
+cl::opt<bool> ENABLE_DEBUG("visualize-debug", cl::init(true), cl::cat(VisualizeCategory),
+  cl::desc("Write each node's debug info and source (+6x slow down)"));
+cl::opt<bool> ENABLE_DIFF("visualize-diff", cl::init(true), cl::cat(VisualizeCategory),
+  cl::desc("Diff each node's IR against the last epoch"));
+cl::opt<bool> PACK_DATA_FILES("visualize-pack", cl::init(false), cl::cat(VisualizeCategory),
+  cl::desc("One data.pack per view instead of .mkdn files"));
+cl::opt<bool> STORE_DATA_OBJECTS("visualize-objects", cl::init(false), cl::cat(VisualizeCategory),
+  cl::desc("Keep node texts once in data/objects/, shared by all epochs"));
+cl::opt<bool> BINARY_GRAPH("visualize-binary", cl::init(true), cl::cat(VisualizeCategory),
+  cl::desc("Also write each view's graph as objects.bin, which the front end loads instead of graph.json"));
+cl::opt<compression_kind> COMPRESSION("visualize-compress",
+  cl::desc("Precompress the files only the front end reads, for it to send as they are"),
+  cl::values(clEnumValN(NO_COMPRESSION,"none","Write them as they are (default)"),
+	     clEnumValN(DEFLATE,"deflate","Write them as name.deflate, with zlib"),
+	     clEnumValN(ZSTD,"zstd","Write them as name.zst, if LLVMVis was built with zstd")),
+  cl::init(NO_COMPRESSION), cl::cat(VisualizeCategory));
+cl::opt<unsigned> LAYOUT_NODES("visualize-layout-nodes", cl::init(500), cl::cat(VisualizeCategory),
+  cl::desc("Lay out views of at least this many nodes in the pass, the browser only draws them (0 for none)"));
+cl::opt<unsigned> MAX_CODE_LENGTH("visualize-max-code", cl::init(1000), cl::cat(VisualizeCategory),
+  cl::desc("Characters of IR kept for a node"));
+cl::opt<unsigned> NUM_THREADS("visualize-threads", cl::init(1), cl::cat(VisualizeCategory),
+  cl::desc("Threads building function views (>1 builds them in parallel)"));
+cl::opt<bool> INCREMENTAL_EPOCHS("visualize-incremental", cl::init(false), cl::cat(VisualizeCategory),
+  cl::desc("Reuse the last epoch's views of unchanged functions"));
+cl::opt<bool> SERVE_VIEWS("visualize-serve", cl::init(false), cl::cat(VisualizeCategory),
+  cl::desc("Serve views on demand over HTTP instead of writing them"));
+cl::opt<unsigned> SERVE_PORT("visualize-port", cl::init(8642), cl::cat(VisualizeCategory),
+  cl::desc("Port on 127.0.0.1 used by -visualize-serve"));
+
+/* Which views are made */
+cl::opt<bool> CREATE_CF_MODULE_VIEW("visualize-module-cf", cl::init(true), cl::cat(VisualizeCategory),
+  cl::desc("Make the module control flow view"));
+cl::opt<bool> CREATE_CF_FUNCTION_VIEWS("visualize-function-cf", cl::init(true), cl::cat(VisualizeCategory),
+  cl::desc("Make the function control flow views"));
+cl::opt<bool> CREATE_DF_FUNCTION_VIEWS("visualize-function-df", cl::init(true), cl::cat(VisualizeCategory),
+  cl::desc("Make the function data flow views"));
+
+/* Addresses and paths */
+cl::opt<string> root_address("visualize-root-address", cl::cat(VisualizeCategory),
+  cl::init("http://137.82.252.51/graph.php?dataset="),
+  cl::desc("The root address used in hyperlinks"));
+cl::opt<string> dataRoot("visualize-data", cl::init("data/"), cl::cat(VisualizeCategory),
+  cl::desc("Folder holding one epochN folder per run"));
+cl::opt<string> epochFile("visualize-epoch-file", cl::cat(VisualizeCategory),
+  cl::init("/var/www/html/data/count.txt"),
+  cl::desc("File counting the epochs"));
+cl::opt<string> webFolder("visualize-web-folder", cl::init("/var/www/html/data/"), cl::cat(VisualizeCategory),
+  cl::desc("Folder the data is synced to"));
+cl::opt<string> syncCommand("visualize-sync-command", cl::cat(VisualizeCategory),
+  cl::desc("Run this once at the end (eg. rsync -az data/ host:/var/www/html/data/) instead of publishing the views"));
+cl::opt<string> onlyDoFuns("visualize-only", cl::init("all"), cl::cat(VisualizeCategory),
+  cl::desc("Only make views of these functions, comma separated (\"all\" for all)"));
+cl::opt<string> hideCallsTo("visualize-hide-calls", cl::init("puts,printf,llvm.dbg.value"),
+  cl::cat(VisualizeCategory),
+  cl::desc("Functions whose calls are hidden from all views, comma separated"));
+
+/* Instrumentation */
+cl::opt<string> REPORT_FILE("visualize-report", cl::cat(VisualizeCategory),
+  cl::desc("Write the time of each stage and view, and what was written, as JSON to this file"));
+cl::opt<string> TRACE_FILE("visualize-trace", cl::cat(VisualizeCategory),
+  cl::desc("Write a Chrome trace (chrome://tracing) of the views built to this file"));
+
+//Fill in the settings the profile decides that weren't given on their
+//own. Called once the options are parsed.
+void apply_options() {
+  if (!ENABLE_IR.getNumOccurrences())
+    ENABLE_IR = PROFILE != SKELETON;
+  if (!ENABLE_DIFF.getNumOccurrences())
+    ENABLE_DIFF = PROFILE != SKELETON;
+  if (!ENABLE_DEBUG.getNumOccurrences())
+    ENABLE_DEBUG = PROFILE == FULL;
+
+  //Fall back to what this build can compress with
+#ifndef LLVMVIS_HAVE_ZSTD
+  if (COMPRESSION == ZSTD) {
+    errs() << "LLVMVis was built without zstd, using deflate\n";
+    COMPRESSION = DEFLATE;
+  }
+#endif
+  if (COMPRESSION == DEFLATE && !zlib::isAvailable()) {
+    errs() << "LLVM was built without zlib, views are not compressed\n";
+    COMPRESSION = NO_COMPRESSION;
+  }
+}
+
+//With neither IR nor debug info every text would only say "Disabled"
+bool writes_node_texts() {
+  return ENABLE_IR || ENABLE_DEBUG;
+}
@@ -0,0 +1,136 @@
+#include "visualize.hpp"
+
+//////////////////////////////////////////////////////////////////
+// Publisher - Puts the files of each view into the web folder	//
+// as soon as the view is written, and switches the epoch into	//
+// place once all of them are there.				//
+//////////////////////////////////////////////////////////////////
+
+//Files published this epoch
+static atomic<unsigned> filesPublished(0);
+
+//Views are published to the web folder as they are written, unless a
+//sync command is given to run at the end instead
+bool publishing() {
+  return DO_SYNC && syncCommand.empty();
+}
+
+//The web folder's copy of this epoch is built here, under a name the
+//front end doesn't list, and renamed to epochN when it is complete
+static string staging_folder() {
+  return webFolder + ".staging-epoch" + to_string(current_epoch) + "/";
+}
+
+//Hard link 'from' to 'to', or copy it if it can't be linked (such as
+//when the web folder is on another file system). Files already in
+//place are left alone, they are either from this epoch or an object
+//with the same hash.
+static bool publish_file(const string &from, const string &to) {
+  if (link(from.c_str(),to.c_str()) == 0) {
+    filesPublished++;
+    return true;
+  }
+  if (errno == EEXIST)
+    return true;
+
+  //A copy is made next to 'to' and renamed, so it is never seen half
+  //written. Its name is unique, as threads storing the same object
+  //publish it at the same time
+  int FD;
+  SmallString<128> tmp;
+  error_code EC = sys::fs::createUniqueFile(to + "-%%%%%%.tmp", FD, tmp);
+  if (!EC) {
+    close(FD);
+    EC = sys::fs::copy_file(from,tmp);
+    if (!EC) EC = sys::fs::rename(tmp,to);
+    if (EC) sys::fs::remove(tmp);
+  }
+  if (EC) {
+    errs() << "Unable to publish " << from << " to " << to << ": " << EC.message() << "\n";
+    return false;
+  }
+  filesPublished++;
+  return true;
+}
+
+//Clear what a run that didn't finish may have left in the staging
+//folder, and create it. Folders are made readable by all (less the
+//umask) like mkdir does, so the web server can read them.
+void begin_publish() {
+  string staging = staging_folder();
+  sys::fs::remove_directories(staging);
+  if (error_code EC = sys::fs::create_directories(staging,true,sys::fs::all_all))
+    errs() << "Unable to create " << staging << ": " << EC.message() << "\n";
+}
+
+//Link every file a view wrote into its folder
+static void link_view(string folder) {
+  stage_timer timer(WRITER_STAGE);
+  StringRef name = sys::path::filename(StringRef(folder).drop_back());
+  string target = staging_folder() + name.str() + "/";
+  if (error_code EC = sys::fs::create_directories(target,true,sys::fs::all_all)) {
+    errs() << "Unable to create " << target << ": " << EC.message() << "\n";
+    return;
+  }
+
+  error_code EC;
+  for (sys::fs::directory_iterator file(folder,EC), end; file != end && !EC; file.increment(EC))
+    publish_file(file->path(),target + sys::path::filename(file->path()).str());
+  if (EC)
+    errs() << "Unable to read " << folder << ": " << EC.message() << "\n";
+}
+
+//Publish every file a view wrote into its folder. This is done by the
+//writer thread, once the files queued before it are written.
+void publish_view(string folder) {
+  after_writes([folder] { link_view(folder); });
+}
+
+//Publish an object of the object store. Objects are shared by every
+//epoch and never change, so they go straight to the web folder.
+void publish_object(const string &path) {
+  stage_timer timer(PUBLISH_STAGE);
+  string target = webFolder + path.substr(dataRoot.size());
+  sys::fs::create_directories(sys::path::parent_path(target),true,sys::fs::all_all);
+  publish_file(path,target);
+}
+
+//Switch the published epoch into place, then write the epoch count the
+//front end reads. Until the count is written it keeps showing the
+//last epoch, so it never sees one that is half published.
+void finish_publish() {
+  stage_timer timer(PUBLISH_STAGE);
+  string staging = staging_folder();
+  string published = webFolder + "epoch" + to_string(current_epoch);
+
+  //An epoch of the same number from a run that didn't finish is moved
+  //out of the way first
+  string old = webFolder + ".old-epoch" + to_string(current_epoch);
+  if (sys::fs::exists(published)) {
+    sys::fs::remove_directories(old);
+    sys::fs::rename(published,old);
+  }
+  if (error_code EC = sys::fs::rename(staging.substr(0,staging.size() - 1),published)) {
+    errs() << "Unable to publish " << published << ": " << EC.message() << "\n";
+    return;
+  }
+  sys::fs::remove_directories(old);
+
+  //The count is written to a temporary file and renamed over the old one
+  string tmp = epochFile + ".tmp";
+  {
+    error_code EC;
+    raw_fd_ostream File(tmp, EC, sys::fs::F_None);
+    if (EC) {
+      errs() << "Unable to write " << tmp << ": " << EC.message() << "\n";
+      return;
+    }
+    File << format("%05d",current_epoch);
+  }
+  if (error_code EC = sys::fs::rename(tmp,epochFile))
+    errs() << "Unable to write " << epochFile << ": " << EC.message() << "\n";
+
+  if (VERBOSE)
+    outs() << " - Published epoch " << current_epoch << " (" << filesPublished
+	   << " files) to " << webFolder << "\n";
+}
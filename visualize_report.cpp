@@ -0,0 +1,220 @@
+#include "visualize.hpp"
+#include "llvm/Pass.h" //TimePassesIsEnabled
+#include <sys/resource.h>
+#include <thread>
+
+//////////////////////////////////////////////////////////////////
+// Report - Where the time of a run goes, stage by stage and view //
+// by view, and how much was made and written.		 //
+//////////////////////////////////////////////////////////////////
+
+static const char *stageNames[NUM_STAGES] = {
+  "naming", "graph", "ir", "debug", "sanitize", "json", "write", "diff", "publish", "layout", "writer"
+};
+
+//What one view took, for the report and the trace
+struct view_record {
+  string title;
+  unsigned thread;
+  double start_ms, end_ms; //Since the pass started
+  double stage_ms[NUM_STAGES] = {};
+  uint64_t nodes = 0, edges = 0, constraints = 0;
+};
+
+typedef chrono::steady_clock report_clock;
+static report_clock::time_point passStart = report_clock::now();
+
+//Totals of the whole run. Times are kept in microseconds so they can
+//be added up atomically from every thread
+static atomic<uint64_t> stageTotals[NUM_STAGES];
+static atomic<uint64_t> totalViews(0), totalNodes(0), totalEdges(0), totalConstraints(0);
+static atomic<uint64_t> filesWritten(0), bytesWritten(0);
+
+static vector<view_record> viewRecords;
+static mutex recordLock;
+
+//The innermost stage and the view being built on this thread
+static thread_local stage_timer *activeStage = nullptr;
+static thread_local view_record *activeView = nullptr;
+
+static double ms_since(report_clock::time_point start) {
+  return chrono::duration<double,milli>(report_clock::now() - start).count();
+}
+
+//Threads are numbered in the order they first finish a view
+static unsigned get_thread_number() {
+  static atomic<unsigned> threads(0);
+  static thread_local unsigned number = threads++;
+  return number;
+}
+
+stage_timer::stage_timer(pass_stage s) : stage(s), outer(activeStage) {
+  activeStage = this;
+  start = report_clock::now();
+}
+
+stage_timer::~stage_timer() {
+  double ms = ms_since(start);
+  activeStage = outer;
+  if (outer) outer->inner_ms += ms;
+
+  double own_ms = ms - inner_ms;
+  stageTotals[stage] += (uint64_t)(own_ms * 1000);
+  if (activeView) activeView->stage_ms[stage] += own_ms;
+}
+
+//Count files (and their bytes) written into the data folder
+void count_written(uint64_t bytes, unsigned files) {
+  bytesWritten += bytes;
+  filesWritten += files;
+}
+
+//Start recording the view this thread is about to build
+void begin_view_report(const string &title) {
+  view_record *record = new view_record;
+  record->title = title;
+  record->start_ms = ms_since(passStart);
+  activeView = record;
+}
+
+//Finish the record of the view this thread built, counting its nodes,
+//edges and constraints
+void end_view_report(const view &v) {
+  unique_ptr<view_record> record(activeView);
+  activeView = nullptr;
+  if (!record) return;
+
+  record->end_ms = ms_since(passStart);
+  record->thread = get_thread_number();
+  record->nodes = v.nodes.size();
+  for (node *n : v.nodes) {
+    record->edges += n->depends.size();
+    record->constraints += n->constraints.size();
+  }
+  totalViews++;
+  totalNodes += record->nodes;
+  totalEdges += record->edges;
+  totalConstraints += record->constraints;
+
+  lock_guard<mutex> guard(recordLock);
+  viewRecords.push_back(std::move(*record));
+}
+
+//Largest the process got, in kilobytes
+static long get_peak_rss() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF,&usage) != 0) return 0;
+  return usage.ru_maxrss;
+}
+
+static void write_stage_times(raw_ostream &OS, const double *stage_ms) {
+  OS << "{";
+  for (int s = 0; s < NUM_STAGES; s++)
+    OS << (s ? ", " : "") << "\"" << stageNames[s] << "\": " << format("%.3f",stage_ms[s]);
+  OS << "}";
+}
+
+//The report: totals of the run, then one entry per view
+static void write_report_file(string filename, double total_ms) {
+  error_code EC;
+  raw_fd_ostream OS(filename, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << "Unable to write " << filename << ": " << EC.message() << "\n";
+    return;
+  }
+
+  double stage_ms[NUM_STAGES];
+  for (int s = 0; s < NUM_STAGES; s++)
+    stage_ms[s] = stageTotals[s] / 1000.0;
+
+  OS << "{\n"
+     << "\t\"epoch\": " << current_epoch << ",\n"
+     << "\t\"threads\": " << NUM_THREADS << ",\n"
+     << "\t\"total_ms\": " << format("%.3f",total_ms) << ",\n"
+     << "\t\"peak_rss_kb\": " << get_peak_rss() << ",\n"
+     << "\t\"views\": " << totalViews << ",\n"
+     << "\t\"views_reused\": " << viewsReused << ",\n"
+     << "\t\"nodes\": " << totalNodes << ",\n"
+     << "\t\"edges\": " << totalEdges << ",\n"
+     << "\t\"constraints\": " << totalConstraints << ",\n"
+     << "\t\"files_written\": " << filesWritten << ",\n"
+     << "\t\"bytes_written\": " << bytesWritten << ",\n"
+     << "\t\"stages_ms\": ";
+  write_stage_times(OS,stage_ms);
+  OS << ",\n\t\"view_list\": [";
+
+  bool first = true;
+  for (const view_record &r : viewRecords) {
+    OS << (first ? "\n" : ",\n") << "\t\t{\"title\": ";
+    first = false;
+    write_json_string(OS,r.title);
+    OS << ", \"thread\": " << r.thread
+       << ", \"ms\": " << format("%.3f",r.end_ms - r.start_ms)
+       << ", \"nodes\": " << r.nodes
+       << ", \"edges\": " << r.edges
+       << ", \"constraints\": " << r.constraints
+       << ", \"stages_ms\": ";
+    write_stage_times(OS,r.stage_ms);
+    OS << "}";
+  }
+  OS << "\n\t]\n}\n";
+}
+
+//A trace in Chrome's trace event format (chrome://tracing, Perfetto).
+//Each view is one event on the thread that built it, with its stage
+//times as arguments.
+static void write_trace_file(string filename, double total_ms) {
+  error_code EC;
+  raw_fd_ostream OS(filename, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << "Unable to write " << filename << ": " << EC.message() << "\n";
+    return;
+  }
+
+  OS << "{\"traceEvents\": [\n"
+     << "{\"name\": \"visualize\", \"ph\": \"X\", \"pid\": 1, \"tid\": 0, \"ts\": 0, \"dur\": "
+     << format("%.0f",total_ms * 1000) << "}";
+  for (const view_record &r : viewRecords) {
+    OS << ",\n{\"name\": ";
+    write_json_string(OS,r.title);
+    OS << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << r.thread + 1
+       << ", \"ts\": " << format("%.0f",r.start_ms * 1000)
+       << ", \"dur\": " << format("%.0f",(r.end_ms - r.start_ms) * 1000)
+       << ", \"args\": ";
+    write_stage_times(OS,r.stage_ms);
+    OS << "}";
+  }
+  OS << "\n]}\n";
+}
+
+//Print the stage times next to -time-passes' own tables
+static void print_stage_times(raw_ostream &OS, double total_ms) {
+  OS << "===" << string(73,'-') << "===\n"
+     << "                         LLVMVis stage timing report\n"
+     << "===" << string(73,'-') << "===\n"
+     << "  Total Execution Time: " << format("%.4f",total_ms / 1000) << " seconds\n\n"
+     << "   ---Wall Time---  --- Name ---\n";
+  for (int s = 0; s < NUM_STAGES; s++) {
+    double ms = stageTotals[s] / 1000.0;
+    OS << format("   %7.4f (%5.1f%%)  ",ms / 1000,total_ms > 0 ? 100 * ms / total_ms : 0.0)
+       << stageNames[s] << (s == WRITER_STAGE ? " (alongside the others)" : "") << "\n";
+  }
+  OS << "   Peak RSS: " << get_peak_rss() << " KB, " << totalNodes << " nodes, "
+     << filesWritten << " files (" << bytesWritten << " bytes) written\n\n";
+}
+
+//Write what was asked for at the end of the pass
+void write_pass_report() {
+  double total_ms = ms_since(passStart);
+  if (!REPORT_FILE.empty())
+    write_report_file(REPORT_FILE,total_ms);
+  if (!TRACE_FILE.empty())
+    write_trace_file(TRACE_FILE,total_ms);
+  if (TimePassesIsEnabled)
+    print_stage_times(errs(),total_ms);
+}
+
+//Start the clock of the pass
+void begin_pass_report() {
+  passStart = report_clock::now();
+}
@@ -0,0 +1,260 @@
+#include "visualize.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <cstring>
+
+//////////////////////////////////////////////////////////////////
+// View server - Keeps the module in memory and builds a view	//
+// the first time it is asked for, instead of all of them	//
+//////////////////////////////////////////////////////////////////
+
+//A view kept in memory by the server, with its json rendered once
+struct served_view {
+  view built;
+  string graph, config;
+  StringMap<node*> nodes;  //By name
+  StringMap<string> diffs; //Filled in as they are asked for
+  last_epoch_view last;
+  bool has_last = false;
+  data_stats stats;
+};
+
+//What a view is of. The module view has no function
+struct view_source {
+  Function *function = nullptr;
+  bool data_flow = false;
+};
+
+struct view_server {
+  Module *module;
+  vector<string> folders;
+  StringMap<view_source> sources; //By view (folder) name
+  StringMap<unique_ptr<served_view> > cache;
+};
+
+//Find a view, building it if this is the first time it was asked for
+static served_view *get_view(view_server &server, StringRef name) {
+  auto cached = server.cache.find(name);
+  if (cached != server.cache.end())
+    return cached->second.get();
+
+  auto source = server.sources.find(name);
+  if (source == server.sources.end())
+    return nullptr;
+
+  unique_ptr<served_view> sv(new served_view);
+  Function *f = source->second.function;
+  if (!f) {
+    build_control_flow_view(*server.module,server.folders,sv->built,nulls());
+  } else {
+    //Nothing is kept from the analyses once the nodes are built
+    DominatorTree DT(*f);
+    LoopInfo LI(DT);
+    if (source->second.data_flow)
+      build_data_flow_view(*f,server.folders,&LI,sv->built,nulls());
+    else
+      build_control_flow_view(*f,server.folders,&LI,sv->built,nulls());
+  }
+
+  vector<node*> &nodes = sv->built.nodes;
+  raw_string_ostream graph(sv->graph);
+  write_graph(graph,sv->built);
+  graph.flush();
+  raw_string_ostream config(sv->config);
+  write_config(config,get_config(nodes.size()),sv->built.title,nodes);
+  config.flush();
+
+  for (node *n : nodes)
+    sv->nodes.insert(make_pair(n->name,n));
+
+  //Diffs are against the newest epoch that was written
+  if (ENABLE_DIFF) {
+    string folder = dataRoot + "epoch" + to_string(current_epoch) + "/" + name.str() + "/";
+    sv->has_last = open_last_epoch(folder,sv->last);
+  }
+
+  served_view *result = sv.get();
+  server.cache[name] = std::move(sv);
+  return result;
+}
+
+//Decode the %XX escapes of a url
+static string url_decode(StringRef str) {
+  string decoded;
+  for (size_t i = 0; i < str.size(); i++) {
+    unsigned value;
+    if (str[i] == '%' && i + 2 < str.size() &&
+	!str.substr(i + 1,2).getAsInteger(16,value)) {
+      decoded += (char)value;
+      i += 2;
+    } else {
+      decoded += str[i];
+    }
+  }
+  return decoded;
+}
+
+//Send all of 'data', however many writes it takes
+static void send_all(int client, StringRef data) {
+  while (!data.empty()) {
+    ssize_t sent = send(client,data.data(),data.size(),MSG_NOSIGNAL);
+    if (sent <= 0) return;
+    data = data.drop_front(sent);
+  }
+}
+
+static void send_response(int client, int status, StringRef type, StringRef body) {
+  string header;
+  raw_string_ostream OS(header);
+  OS << "HTTP/1.0 " << status << (status == 200 ? " OK" : " Not Found") << "\r\n"
+     << "Content-Type: " << type << "; charset=utf-8\r\n"
+     << "Content-Length: " << body.size() << "\r\n"
+     << "Access-Control-Allow-Origin: *\r\n"
+     << "Connection: close\r\n\r\n";
+  send_all(client,OS.str());
+  send_all(client,body);
+}
+
+//Answer one request. The paths are:
+//  /views			The views that can be asked for, one per line
+//  /<view>/graph.json
+//  /<view>/config.json
+//  /<view>/<ir|src|diff>/<node>	One of a node's texts
+static int handle_request(view_server &server, int client, StringRef path) {
+  path = path.split('?').first;
+  SmallVector<StringRef,4> parts;
+  path.split(parts,'/',3,false);
+
+  if (parts.size() == 1 && parts[0] == "views") {
+    string list;
+    for (const string &folder : server.folders)
+      list += folder + "\n";
+    send_response(client,200,"text/plain",list);
+    return 200;
+  }
+
+  served_view *sv = parts.empty() ? nullptr : get_view(server,url_decode(parts[0]));
+  if (sv && parts.size() == 2 && parts[1] == "graph.json") {
+    send_response(client,200,"application/json",sv->graph);
+    return 200;
+  }
+  if (sv && parts.size() == 2 && parts[1] == "config.json") {
+    send_response(client,200,"application/json",sv->config);
+    return 200;
+  }
+
+  if (sv && parts.size() == 3 && writes_node_texts()) {
+    auto n = sv->nodes.find(url_decode(parts[2]));
+    if (n != sv->nodes.end()) {
+      node *found = n->second;
+      if (parts[1] == "ir") {
+	send_response(client,200,"text/plain",found->metadata);
+	return 200;
+      }
+      if (parts[1] == "src") {
+	send_response(client,200,"text/plain",found->src);
+	return 200;
+      }
+      if (parts[1] == "diff") {
+	auto diff = sv->diffs.find(found->name);
+	if (diff == sv->diffs.end()) {
+	  string text = sv->has_last ? diff_last_epoch(sv->last,found,sv->stats) : "";
+	  diff = sv->diffs.insert(make_pair(found->name,text)).first;
+	}
+	send_response(client,200,"text/plain",diff->second);
+	return 200;
+      }
+    }
+  }
+
+  send_response(client,404,"text/plain","Not found\n");
+  return 404;
+}
+
+//Read the request line of an HTTP request, e.g. "GET /views HTTP/1.1",
+//and return its path. The headers are read but not needed.
+static bool read_request(int client, string &path) {
+  string request;
+  char buffer[4096];
+  while (request.find("\r\n\r\n") == string::npos && request.size() < 65536) {
+    ssize_t got = recv(client,buffer,sizeof(buffer),0);
+    if (got <= 0) break;
+    request.append(buffer,got);
+  }
+
+  StringRef line = StringRef(request).split("\r\n").first;
+  SmallVector<StringRef,3> fields;
+  line.split(fields,' ',-1,false);
+  if (fields.size() < 2 || fields[0] != "GET")
+    return false;
+  path = fields[1].str();
+  return true;
+}
+
+//Keep the module in memory and serve its views over HTTP on
+//SERVE_PORT, building each one the first time it is asked for. Only
+//returns if the server can't be started.
+void serve_views(Module &m, vector<string> folders) {
+  view_server server;
+  server.module = &m;
+  server.folders = folders;
+
+  if (CREATE_CF_MODULE_VIEW)
+    server.sources["Module_Control_" + get_name(&m)] = view_source();
+  for (Function &f : m) {
+    if (f.isDeclaration()) continue;
+    if (onlyDoFuns != "all" &&
+	onlyDoFuns.find(get_name(&f)) == string::npos)
+      continue;
+
+    view_source source;
+    source.function = &f;
+    if (CREATE_CF_FUNCTION_VIEWS)
+      server.sources["Function_Control_" + get_name(&f)] = source;
+    source.data_flow = true;
+    if (CREATE_DF_FUNCTION_VIEWS)
+      server.sources["Function_Data_" + get_name(&f)] = source;
+  }
+
+  int sock = socket(AF_INET,SOCK_STREAM,0);
+  int reuse = 1;
+  setsockopt(sock,SOL_SOCKET,SO_REUSEADDR,&reuse,sizeof(reuse));
+
+  //Only local clients (the web server) can connect
+  sockaddr_in addr;
+  memset(&addr,0,sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((uint16_t)SERVE_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (sock < 0 || ::bind(sock,(sockaddr*)&addr,sizeof(addr)) < 0 || listen(sock,16) < 0) {
+    errs() << "Unable to serve views on port " << SERVE_PORT << ": " << strerror(errno) << "\n";
+    if (sock >= 0) close(sock);
+    return;
+  }
+
+  if (VERBOSE)
+    outs() << " - Serving " << server.sources.size() << " views on http://127.0.0.1:"
+	   << SERVE_PORT << "/\n";
+
+  while (true) {
+    int client = accept(sock,nullptr,nullptr);
+    if (client < 0) {
+      if (errno == EINTR) continue;
+      errs() << "View server stopped: " << strerror(errno) << "\n";
+      break;
+    }
+
+    string path;
+    auto start = chrono::steady_clock::now();
+    if (read_request(client,path)) {
+      int status = handle_request(server,client,path);
+      if (VERBOSE)
+	outs() << "GET " << path << " " << status << " ("
+	       << format("%.1f", chrono::duration<double,milli>(chrono::steady_clock::now() - start).count())
+	       << " ms)\n";
+    }
+    close(client);
+  }
+  close(sock);
+}
@@ -0,0 +1,176 @@
+#include "visualize.hpp"
+#include "llvm/Support/Compression.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+#ifdef LLVMVIS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+//////////////////////////////////////////////////////////////////
+// Writer - Views hand their finished files to a thread that	//
+// writes them, so building the next view overlaps with the disk //
+//////////////////////////////////////////////////////////////////
+
+//Past this many bytes waiting to be written, views wait for the writer
+//to catch up, so memory stays bounded when the disk is slow
+#define MAX_QUEUED_BYTES (64 << 20)
+
+//Files smaller than this aren't worth compressing, they are written as
+//they are even with -visualize-compress
+#define MIN_COMPRESSED_BYTES 512
+
+//zstd's level for precompressed files. They are written once and sent
+//many times, so a bit more time goes into making them small
+#define ZSTD_LEVEL 9
+
+//A file to write, or a task to run once everything queued before it
+//is written
+struct write_job {
+  string path;
+  string text;
+  bool compressed;
+  function<void()> task;
+};
+
+static deque<write_job> writeQueue;
+static size_t queuedBytes = 0;
+static bool writerStop = false;
+static std::thread writer;
+static mutex writeLock;
+static condition_variable writeReady, writeDone;
+
+//Folders with a file that couldn't be written. Only the writer thread
+//uses it
+static StringSet<> failedFolders;
+
+//Compress 'text' the way -visualize-compress says, and give the
+//suffix of the file it goes in. Returns false if it can't be
+static bool compress_text(StringRef text, SmallVectorImpl<char> &out, string &suffix) {
+#ifdef LLVMVIS_HAVE_ZSTD
+  if (COMPRESSION == ZSTD) {
+    out.resize(ZSTD_compressBound(text.size()));
+    size_t size = ZSTD_compress(out.data(),out.size(),text.data(),text.size(),ZSTD_LEVEL);
+    if (ZSTD_isError(size)) return false;
+    out.resize(size);
+    suffix = ".zst";
+    return true;
+  }
+#endif
+  if (zlib::compress(text,out) != zlib::StatusOK)
+    return false;
+  suffix = ".deflate";
+  return true;
+}
+
+//Returns false if the file couldn't be written
+static bool write_job_file(const write_job &job) {
+  stage_timer timer(WRITER_STAGE);
+  string path = job.path;
+  StringRef text = job.text;
+
+  SmallVector<char,0> compressed;
+  string suffix;
+  if (job.compressed && COMPRESSION != NO_COMPRESSION && text.size() >= MIN_COMPRESSED_BYTES
+      && compress_text(text,compressed,suffix)) {
+    path += suffix;
+    text = StringRef(compressed.data(),compressed.size());
+  }
+
+  error_code EC;
+  raw_fd_ostream File(path, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << "Unable to write " << path << ": " << EC.message() << "\n";
+    return false;
+  }
+  File << text;
+  File.close();
+  if (File.has_error()) {
+    errs() << "Unable to write " << path << "\n";
+    File.clear_error();
+    return false;
+  }
+  count_written(text.size());
+  return true;
+}
+
+//Take everything queued at once, so many small files cost one trip
+//through the lock, and write it in order
+static void run_writer() {
+  unique_lock<mutex> lock(writeLock);
+  while (true) {
+    writeReady.wait(lock,[] { return writerStop || !writeQueue.empty(); });
+    if (writeQueue.empty()) return;
+
+    deque<write_job> batch;
+    batch.swap(writeQueue);
+    lock.unlock();
+
+    for (write_job &job : batch) {
+      if (job.task)
+	job.task();
+      else if (!write_job_file(job))
+	failedFolders.insert(sys::path::parent_path(job.path));
+
+      size_t done = job.text.size();
+      job.text = string();
+      lock.lock();
+      queuedBytes -= done;
+      writeDone.notify_all();
+      lock.unlock();
+    }
+
+    lock.lock();
+  }
+}
+
+static void queue_job(write_job job) {
+  unique_lock<mutex> lock(writeLock);
+  if (!writer.joinable()) {
+    writerStop = false;
+    writer = std::thread(run_writer);
+  }
+
+  //Back-pressure: wait for room, unless nothing else is waiting (a
+  //single file bigger than the limit still has to go through)
+  writeDone.wait(lock,[&] { return queuedBytes == 0 || queuedBytes + job.text.size() <= MAX_QUEUED_BYTES; });
+  queuedBytes += job.text.size();
+  writeQueue.push_back(std::move(job));
+  writeReady.notify_one();
+}
+
+//Write 'text' to 'path' in the background
+void write_file(string path, string text, bool compressed) {
+  write_job job;
+  job.path = std::move(path);
+  job.text = std::move(text);
+  job.compressed = compressed;
+  queue_job(std::move(job));
+}
+
+//Run 'task' on the writer once every file queued before it is written
+void after_writes(function<void()> task) {
+  write_job job;
+  job.compressed = false;
+  job.task = std::move(task);
+  queue_job(std::move(job));
+}
+
+//Whether every file queued into 'folder' so far was written. Only for
+//tasks run by after_writes, which the writer runs once those files are
+//done
+bool folder_written(StringRef folder) {
+  return !failedFolders.count(folder.rtrim('/'));
+}
+
+//Write what is left and stop the writer thread
+void stop_writer() {
+  {
+    lock_guard<mutex> lock(writeLock);
+    writerStop = true;
+    writeReady.notify_one();
+  }
+  if (writer.joinable())
+    writer.join();
+}
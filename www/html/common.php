@@ -7,6 +7,11 @@ $dataset    = 'default';
 $dataset_qs = ''; //Query string
 $epoch = 'epoch0';
 
+//Address of a running view server (the pass run with -visualize-serve), such as
+//'http://127.0.0.1:8642'. When set, views are read from it instead of
+//the data folder
+$view_server = '';
+
 //Get the epoch number (run number) from either the 'count' file, or
 //the url, if neither are found, use epoch0
 if (isset($_GET['epoch'])) {
@@ -23,7 +28,7 @@ if (isset($_GET['epoch'])) {
 //Get the dataset name from the url
 if (isset($_GET['dataset'])) {
     if (!preg_match('@[^a-z0-9-_ ]@i', $_GET['dataset'])) {
-        if (is_dir('data/' . $epoch . '/' . $_GET['dataset'])) {
+        if ($view_server != '' || is_dir('data/' . $epoch . '/' . $_GET['dataset'])) {
             $dataset    = $_GET['dataset'];
             $dataset_qs = "?dataset=$dataset";
 
@@ -31,25 +36,190 @@ if (isset($_GET['dataset'])) {
     }
 }
 
-//Load in the data used in the side bar (written in markdown)
-function get_html_docs($obj) {
-    global $config, $data, $dataset, $errors, $epoch;
+//The folder a view's files are in. A view that was reused from an
+//earlier epoch (its function didn't change) only holds origin.txt,
+//naming the folder it reuses
+function view_folder() {
+    global $dataset, $epoch, $view_server;
+    static $folder = null;
+
+    if ($view_server != '') {
+        return "$view_server/$dataset";
+    }
+    if ($folder === null) {
+        $folder = "data/$epoch/$dataset";
+        if (is_reused_view()) {
+            $folder = "data/" . trim(file_get_contents("$folder/origin.txt"));
+        }
+    }
+    return $folder;
+}
+
+//True if the view was reused from an earlier epoch, so nothing in it
+//changed since the last one
+function is_reused_view() {
+    global $dataset, $epoch, $view_server;
+    return $view_server == '' && file_exists("data/$epoch/$dataset/origin.txt");
+}
+
+//Precompressed files the pass writes (-visualize-compress), by suffix,
+//and the Content-Encoding they are sent with
+$compressed_suffixes = array('zst' => 'zstd', 'deflate' => 'deflate');
 
-    $name = str_replace('/', '_', $obj['name']);
-    $filename = "data/$epoch/$dataset/$name.mkdn";
-    $src_filename = "data/$epoch/$dataset/$name.src.mkdn";
-    $diff_filename = "data/$epoch/$dataset/$name.diff.mkdn";    
+//Read a file of a view. A file the pass compressed is only there as
+//name.zst or name.deflate, and is decompressed here. Returns false if
+//there is no such file (or no zstd extension to read it)
+function read_view_file($filename) {
+    global $view_server, $compressed_suffixes;
 
-    $name = str_replace('_', '\_', $obj['name']);
-    $type = $obj['type'];
-    if ($config['types'][$type]) {
-        $type = $config['types'][$type]['short'];
+    if ($view_server != '' || file_exists($filename)) {
+        return @file_get_contents($filename);
     }
-    
-    $group = $obj['group'];
-    if ($config['groups'][$group]) {
-        $type = $config['types'][$type]['short'];
+    foreach ($compressed_suffixes as $suffix => $encoding) {
+        if (!file_exists("$filename.$suffix")) {
+            continue;
+        }
+        $compressed = file_get_contents("$filename.$suffix");
+        if ($suffix == 'deflate') {
+            return gzuncompress($compressed);
+        }
+        if (function_exists('zstd_uncompress')) {
+            return zstd_uncompress($compressed);
+        }
+    }
+    return false;
+}
+
+//True if the file of a view is there, as it is or precompressed
+function view_file_exists($filename) {
+    global $compressed_suffixes;
+
+    if (file_exists($filename)) {
+        return true;
     }
+    foreach ($compressed_suffixes as $suffix => $encoding) {
+        if (file_exists("$filename.$suffix")) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//The file of a view that is sent to the browser: the file itself, or a
+//precompressed one the browser accepts (by its Accept-Encoding).
+//Returns the filename and its Content-Encoding ('' if none), or false
+//if there is no such file
+function find_view_file($filename) {
+    global $compressed_suffixes;
+
+    if (file_exists($filename)) {
+        return array($filename, '');
+    }
+    $accepted = isset($_SERVER['HTTP_ACCEPT_ENCODING']) ? $_SERVER['HTTP_ACCEPT_ENCODING'] : '';
+    foreach ($compressed_suffixes as $suffix => $encoding) {
+        if (file_exists("$filename.$suffix") && stripos($accepted, $encoding) !== false) {
+            return array("$filename.$suffix", $encoding);
+        }
+    }
+    return false;
+}
+
+//Read data.index of a packed view, once per request. Each line is the
+//node name followed by the offset and length of its IR, source and
+//diff texts within data.pack
+function get_pack_index() {
+    static $index = null;
+
+    if ($index === null) {
+        $index = array();
+        $filename = view_folder() . "/data.index";
+        if (file_exists($filename)) {
+            foreach (file($filename, FILE_IGNORE_NEW_LINES) as $line) {
+                $fields = explode("\t", $line);
+                $index[$fields[0]] = array_map('intval', array_slice($fields, 1));
+            }
+        }
+    }
+    return $index;
+}
+
+//Read data.refs of a view in the object store, once per request. Each
+//line is the node name followed by the hashes of its IR, source and
+//diff texts
+function get_ref_index() {
+    static $index = null;
+
+    if ($index === null) {
+        $index = array();
+        $filename = view_folder() . "/data.refs";
+        if (file_exists($filename)) {
+            foreach (file($filename, FILE_IGNORE_NEW_LINES) as $line) {
+                $fields = explode("\t", $line);
+                $index[$fields[0]] = array_slice($fields, 1);
+            }
+        }
+    }
+    return $index;
+}
+
+//Read one of the texts of a node: 'ir', 'src' or 'diff'. They are
+//either separate .mkdn files, packed into data.pack, or objects in
+//data/objects/ shared by all epochs. Returns false if the node has no
+//documentation.
+function read_node_data($name, $kind) {
+    global $dataset, $epoch, $view_server;
+    static $pack = null;
+    $kinds = array('ir' => 0, 'src' => 1, 'diff' => 2);
+    $suffix = array('ir' => '.mkdn', 'src' => '.src.mkdn', 'diff' => '.diff.mkdn');
+
+    if ($view_server != '') {
+        return @file_get_contents(view_folder() . "/$kind/" . rawurlencode($name));
+    }
+
+    if ($kind == 'diff' && is_reused_view()) {
+        return '';
+    }
+
+    $refs = get_ref_index();
+    if (count($refs) > 0) {
+        if (!isset($refs[$name])) {
+            return false;
+        }
+        $hash = $refs[$name][$kinds[$kind]];
+        $filename = "data/objects/" . substr($hash, 0, 2) . "/" . substr($hash, 2);
+        return file_exists($filename) ? file_get_contents($filename) : false;
+    }
+
+    $index = get_pack_index();
+    if (count($index) == 0) {
+        return read_view_file(view_folder() . "/" . str_replace('/', '_', $name) . $suffix[$kind]);
+    }
+
+    if (!isset($index[$name])) {
+        return false;
+    }
+    if ($pack === null) {
+        $pack = fopen(view_folder() . "/data.pack", "rb");
+    }
+    $offset = $index[$name][2 * $kinds[$kind]];
+    $length = $index[$name][2 * $kinds[$kind] + 1];
+    if ($length == 0) {
+        return '';
+    }
+    fseek($pack, $offset);
+    return fread($pack, $length);
+}
+
+//Load in the data used in the side bar (written in markdown). The
+//graph isn't read: the type (its short name) and group come from the
+//browser, which also fills in the "depends" div and marks the links to
+//objects that aren't in the view
+function get_html_docs($obj_name, $type, $group) {
+    global $dataset, $epoch;
+
+    $name  = str_replace('_', '\_', htmlspecialchars($obj_name));
+    $type  = htmlspecialchars($type);
+    $group = htmlspecialchars($group);
     
     //Beginning of markdown
     $markdown = file_get_contents("markdown_header.html");
@@ -58,32 +228,30 @@ function get_html_docs($obj) {
     $markdown .= "<b>Type:</b> $type<br />";
     $markdown .= "<b>Group:</b> $group<hr>";
 
-
-    if ($obj) {
-        $markdown .= get_depends_markdown('<b>Depends on:</b> ',     $obj['depends'])."<br />";
-        $markdown .= get_depends_markdown('<b>Depended on by:</b> ', $obj['dependedOnBy'])."<br />\n\n";
-        $markdown .= get_epochs($obj['name'])."<br />";                
-    }
+    $markdown .= "<div class=\"depends\"></div>\n\n";
+    $markdown .= get_epochs()."<br />";
 
     
-    //Read in the data from the .mkdn file
-    if (file_exists($filename)) {
+    //Read in the data from the .mkdn files (or data.pack)
+    $ir = read_node_data($obj_name, 'ir');
+    if ($ir !== false) {
         $markdown .= file_get_contents("markdown_tabs.html");
         
         $markdown .= "<div id=\"IR\" class=\"tabcontent show\"> <pre class=\"prettyprint lang-llvm \">";
-        $markdown .= file_get_contents($filename);
+        $markdown .= $ir;
         $markdown .= "</pre></div>\n";
 
         $markdown .= "<div id=\"Source\" class=\"tabcontent\"><pre class=\"prettyprint lang-llvm \">";
-        $markdown .= file_get_contents($src_filename);        
+        $markdown .= read_node_data($obj_name, 'src');
         $markdown .= "</pre></div>\n";
 
         $markdown .= "<div id=\"Diff\" class=\"tabcontent\"><pre class=\"prettyprint lang-llvm \">";
-        $markdown .= file_get_contents($diff_filename);        
+        $markdown .= read_node_data($obj_name, 'diff');
         $markdown .= "</pre></div>\n";
 
     } else {
-        $markdown .= "<div class=\"alert alert-warning\">No documentation for this object</div>";
+        //The pass writes no texts with -visualize-profile=skeleton
+        $markdown .= "<div class=\"alert alert-info\">IR and source are disabled for this view</div>";
     }
 
     $markdown .= get_views();
@@ -96,12 +264,7 @@ function get_html_docs($obj) {
         $name      = $pieces[0];
         $id_string = get_id_string($name);
         $name_esc  = str_replace('_', '\_', $name);
-        $class     = 'select-object';
-        if (!isset($data[$name])) {
-            $class .= ' missing';
-            $errors[] = "Object \"$obj[name]\" links to unrecognized object \"$name\"";
-        }
-        $markdown .= "<a href=\"#$id_string\" class=\"$class\" data-name=\"$name\">$name_esc</a>";
+        $markdown .= "<a href=\"#$id_string\" class=\"select-object\" data-name=\"$name\">$name_esc</a>";
         $markdown .= $pieces[1];
     }
 
@@ -144,10 +307,13 @@ function get_epochs() {
 
 //Get the list of epochs available from the data/ directory
 function get_views() {
-    global $dataset, $epoch;
+    global $dataset, $epoch, $view_server;
 
     $directory = "data/".$epoch."/*";
     $phpfiles = glob($directory);
+    if ($view_server != '') {
+        $phpfiles = file("$view_server/views", FILE_IGNORE_NEW_LINES);
+    }
 
     $markdown = "<b>Views:</b><br />";    
     foreach ($phpfiles as $phpfile) {
@@ -159,43 +325,54 @@ function get_views() {
 }
                   
 
-//Create a list of all the dependencies. Make them clickable.
-function get_depends_markdown($header, $arr) {
-    $markdown = "$header";
-    if (count($arr)) {
-        $markdown .= "";
-        foreach ($arr as $name) {
-            $markdown .= "{{" . $name . "}}, ";
-        }
-        $markdown .= "";
-    } else {
-        $markdown .= "None";
-    }
-    return $markdown;
-}
-
 function get_id_string($name) {
     return 'obj-' . preg_replace('@[^a-z0-9]+@i', '-', $name);
 }
 
 //Read in the config.json file
 function read_config() {
-    global $config, $dataset, $dataset_qs, $epoch;
+    global $config, $dataset, $dataset_qs, $epoch, $view_server;
 
-    $config = json_decode(file_get_contents("data/$epoch/$dataset/config.json" ), true);
+    $config = json_decode(read_view_file(view_folder() . "/config.json"), true);
 
     //Not entirely sure what this is for, but I gather it is the
     //connection between the php and javascript
     $config['jsonUrl'] = "json.php$dataset_qs&epoch=$epoch"; 
+    $config['docsUrl'] = "docs.php?dataset=" . urlencode($dataset) . "&epoch=$epoch";
+
+    //The graph is loaded from objects.bin when the pass wrote it
+    if ($view_server == '' && view_file_exists(view_folder() . "/objects.bin")) {
+        $config['graphUrl'] = "view_file.php?dataset=" . urlencode($dataset) . "&epoch=$epoch&file=objects.bin";
+    }
+
+    //The links of graph.json and objects.bin come with their
+    //constraints applied, so only the position constraints are sent to
+    //the browser
+    if ($view_server != '' || view_file_exists(view_folder() . "/graph.json")) {
+        $config['constraints'] = array_values(array_filter($config['constraints'], function($c) {
+            return $c['type'] == 'position';
+        }));
+    }
 }
 
-//Read in the data file from objects.json
+//Read in the graph of the view. Only its structure is read, the docs of
+//each node are rendered by docs.php when it is selected
 function read_data() {
     global $config, $data, $dataset, $errors, $epoch;
 
     if (!$config) read_config();
 
-    $json   = json_decode(file_get_contents("data/$epoch/$dataset/objects.json"), true);    
+    //graph.json already has the edges both ways, and the errors
+    $graph = read_view_file(view_folder() . "/graph.json");
+    if ($graph !== false) {
+        $graph  = json_decode($graph, true);
+        $data   = $graph['data'];
+        $errors = $graph['errors'];
+        return;
+    }
+
+    //Views from before graph.json have only objects.json
+    $json   = json_decode(read_view_file(view_folder() . "/objects.json"), true);    
     $data   = array();
     $errors = array();
 
@@ -217,9 +394,5 @@ function read_data() {
         }
     }
     unset($obj);
-    foreach ($data as &$obj) {
-                $obj['docs'] = get_html_docs($obj);
-    }
-    unset($obj);
 }
 ?>
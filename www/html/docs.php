@@ -0,0 +1,26 @@
+<?php
+//Render the side panel of one node, when it is selected. An epoch's
+//docs don't change once it is published, so the browser caches them
+//by epoch, view and node, and checks back with the ETag
+require_once 'common.php';
+
+$name  = isset($_GET['name'])  ? $_GET['name']  : '';
+$type  = isset($_GET['type'])  ? $_GET['type']  : '';
+$group = isset($_GET['group']) ? $_GET['group'] : '';
+
+header('Content-Type: text/html; charset=utf-8');
+if ($view_server == '') {
+    //The folder's time tells apart two runs that made the same epoch
+    $etag = '"' . md5("$epoch/$dataset/$name/$type/$group/" . filemtime(view_folder())) . '"';
+    header("ETag: $etag");
+    header('Cache-Control: public, max-age=86400');
+    if (isset($_SERVER['HTTP_IF_NONE_MATCH']) && trim($_SERVER['HTTP_IF_NONE_MATCH']) == $etag) {
+        http_response_code(304);
+        exit;
+    }
+}
+
+//The browser sends the node's type and group, so neither graph.json nor
+//config.json is read
+echo get_html_docs($name, $type, $group);
+?>
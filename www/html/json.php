@@ -1,5 +1,23 @@
 <?php
 require_once 'common.php';
+
+//graph.json is what is sent, as it is on disk (precompressed if the
+//browser accepts it)
+if ($view_server == '') {
+    $found = find_view_file(view_folder() . "/graph.json");
+    if ($found !== false) {
+        list($path, $encoding) = $found;
+        header('Content-type: application/json');
+        header('Vary: Accept-Encoding');
+        if ($encoding != '') {
+            header("Content-Encoding: $encoding");
+        }
+        header('Content-Length: ' . filesize($path));
+        readfile($path);
+        exit;
+    }
+}
+
 read_data();
 
 header('Content-type: application/json');
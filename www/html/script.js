@@ -22,28 +22,48 @@ $(function() {
         $('body').addClass('firefox');
     }
 
-    //Get the data which php read
-    d3.json(config.jsonUrl, function(data) {
-        if (data.errors.length) {
-            alert('Data error(s):\n\n' + data.errors.join('\n'));
-            return;
-        }
+    //Get the graph which php read, from the binary graph (objects.bin)
+    //when there is one. The docs of a node are only loaded when it is
+    //selected (see showDocs)
+    if (config.graphUrl) {
+        d3.xhr(config.graphUrl).responseType('arraybuffer').get(function(error, request) {
+            if (error) {
+                alert('Unable to load ' + config.graphUrl);
+                return;
+            }
+            var decoded = decodeGraph(request.response);
+            if (decoded.errors.length) {
+                alert('Data error(s):\n\n' + decoded.errors.join('\n'));
+                return;
+            }
+            graph.data      = decoded.data;
+            graph.madeLinks = decoded.links;
+            showGraph();
+        });
+    } else {
+        d3.json(config.jsonUrl, function(data) {
+            if (data.errors.length) {
+                alert('Data error(s):\n\n' + data.errors.join('\n'));
+                return;
+            }
+            graph.data = data.data;
+            graph.madeLinks = makeLinks(graph.data);
+            showGraph();
+        });
+    }
 
-	//Load and display the graph
-        graph.data = data.data;
-        drawGraph();
+    function showGraph() {
+	drawGraph();
 
 	//Open the documentation panel for the helper node (instead of being blank)
 	for (var name in graph.data) {
             var obj = graph.data[name];
 	    if (obj.type == "Helper" || obj.group == "Helper" || obj.name == "main") {
-		$('#docs').html(obj.docs);
-		$('#docs-container').scrollTop(0);
+		showDocs(obj);
 		break;
 	    }
 	}
-	
-    });
+    }
 
     //The documents close button
     $('#docs-close').on('click', function() {
@@ -64,9 +84,178 @@ $(function() {
     $(window).on('resize', resize);
 });
 
+//Decode objects.bin (written by visualize_graph.cpp, which describes
+//the format) into the same objects graph.json holds, and the links
+//between them. Typed arrays are used straight on the file, so this
+//relies on the browser being little endian, as they all are.
+function decodeGraph(buffer) {
+    var header  = new Uint32Array(buffer, 0, 6),
+        version = (header[0] >>> 24) - 0x30; //"LVG1", "LVG2"...
+    if ((header[0] & 0xffffff) != 0x47564c || version < 1 || version > 3) {
+        throw 'Not a binary graph';
+    }
+    //"LVG2" adds where each node goes, and "LVG3" the errors
+    var laidOut    = (version >= 2),
+        headerSize = (version >= 3 ? 6 : 5),
+        numStrings = header[1],
+        numNodes   = header[2],
+        numEdges   = header[3],
+        numStyles  = header[4],
+        numErrors  = (version >= 3 ? header[5] : 0),
+        numWords   = headerSize + numStrings + 4 * numNodes + 1 + 2 * numEdges + 3 * numStyles
+                     + (laidOut ? 2 * numNodes : 0) + numErrors,
+        words      = new Uint32Array(buffer, 0, numWords),
+        floats     = new Float32Array(buffer, 0, numWords),
+        at         = headerSize;
+
+    function column(array, length) {
+        at += length;
+        return array.subarray(at - length, at);
+    }
+    var stringEnds = column(words, numStrings),
+        names      = column(words, numNodes),
+        types      = column(words, numNodes),
+        groups     = column(words, numNodes),
+        firstEdge  = column(words, numNodes + 1),
+        sources    = column(words, numEdges),
+        edgeStyles = column(words, numEdges),
+        strengths  = column(floats, numStyles),
+        widths     = column(floats, numStyles),
+        colors     = column(words, numStyles),
+        xs         = laidOut ? column(floats, numNodes) : null,
+        ys         = laidOut ? column(floats, numNodes) : null,
+        errorIds   = column(words, numErrors);
+
+    //The text is decoded at once. Unless it is all ASCII, offsets into
+    //it aren't offsets into the decoded string, and each string is
+    //decoded on its own
+    var text    = new Uint8Array(buffer, 4 * numWords),
+        decoder = new TextDecoder('utf-8'),
+        all     = decoder.decode(text),
+        ascii   = (all.length == text.length),
+        strings = new Array(numStrings),
+        start   = 0;
+    for (var i = 0; i < numStrings; i++) {
+        strings[i] = ascii ? all.slice(start, stringEnds[i])
+                           : decoder.decode(text.subarray(start, stringEnds[i]));
+        start = stringEnds[i];
+    }
+
+    var data  = {},
+        nodes = new Array(numNodes),
+        links = new Array(numEdges);
+    for (var i = 0; i < numNodes; i++) {
+        nodes[i] = data[strings[names[i]]] = {
+            name         : strings[names[i]],
+            type         : strings[types[i]],
+            group        : strings[groups[i]],
+            depends      : [],
+            dependedOnBy : []
+        };
+        if (laidOut && !isNaN(xs[i])) {
+            nodes[i].layout = [xs[i], ys[i]];
+        }
+    }
+    for (var i = 0; i < numNodes; i++) {
+        var obj = nodes[i];
+        for (var e = firstEdge[i]; e < firstEdge[i + 1]; e++) {
+            var source = nodes[sources[e]],
+                style  = edgeStyles[e];
+            obj.depends.push(source.name);
+            source.dependedOnBy.push(obj.name);
+            links[e] = {
+                source   : source,
+                target   : obj,
+                strength : strengths[style],
+                color    : strings[colors[style]],
+                width    : widths[style]
+            };
+        }
+    }
+    var errors = [];
+    for (var i = 0; i < numErrors; i++) {
+        errors.push(strings[errorIds[i]]);
+    }
+    return { data : data, links : links, errors : errors };
+}
+
 //Everything to do with loading the graph from graph.data into a
 //node/link format to be used in d3
 function loadGraph() {
+    graph.laidOut = false;
+    if (graph.madeLinks) {
+        loadPositions();
+        placeNodes();
+        graph.links = graph.madeLinks;
+    } else {
+        loadLinks();
+    }
+    loadCategories();
+}
+
+//Large views are laid out by the pass ("layout" is from 0 to 1 across
+//and down), already keeping to the position constraints. Their nodes
+//are pinned there, and the force simulation doesn't move them
+function placeNodes() {
+    for (var name in graph.data) {
+        if (!graph.data[name].layout) {
+            return;
+        }
+    }
+    for (var name in graph.data) {
+        var obj = graph.data[name];
+        obj.x = obj.px = obj.layout[0] * graph.width;
+        obj.y = obj.py = obj.layout[1] * graph.height;
+        obj.fixed = true;
+        obj.positionConstraints = [];
+    }
+    graph.laidOut = true;
+}
+
+//Make the links of graph.json, which the pass made with their
+//constraints applied. Returns null for views from before graph.json,
+//whose links are made from the constraints (see loadLinks)
+function makeLinks(data) {
+    var links = [];
+    for (var name in data) {
+        var obj = data[name];
+        if (!obj.links) {
+            return null;
+        }
+        obj.links.forEach(function(l) {
+            links.push({
+                source   : data[l.source],
+                target   : obj,
+                strength : l.strength,
+                color    : l.color,
+                width    : l.width
+            });
+        });
+    }
+    return links;
+}
+
+//Graphs from graph.json and objects.bin come with their links made,
+//only the position constraints of config.json are left to read
+function loadPositions() {
+    var positions = {};
+    config.constraints.forEach(function(c) {
+        if (c.type == 'position') {
+            (positions[c.has.name] = positions[c.has.name] || []).push({
+                weight : c.weight,
+                x      : c.x * graph.width,
+                y      : c.y * graph.height
+            });
+        }
+    });
+    for (var name in graph.data) {
+        graph.data[name].positionConstraints = positions[name] || [];
+    }
+}
+
+//Read the constraints of config.json into the objects of objects.json,
+//and make the links between them
+function loadLinks() {
 
     //Parse the objects.json data
     for (var name in graph.data) {
@@ -162,8 +351,10 @@ function loadGraph() {
             graph.links.push(link);
         }
     }
+}
 
-    //Parse in type, and group from config.json data
+//Parse in type, and group from config.json data
+function loadCategories() {
     graph.categories = {};
     for (var name in graph.data) {
         var obj = graph.data[name],
@@ -507,10 +698,16 @@ function drawGraph() {
         graph.numTicks = 0;
         graph.preventCollisions = false;
         graph.force.start();
-        for (var i = 0; i < config.graph.ticksWithoutCollisions; i++) {
+        if (graph.laidOut) {
+            //One tick draws the nodes where they are
             graph.force.tick();
+            graph.force.stop();
+        } else {
+            for (var i = 0; i < config.graph.ticksWithoutCollisions; i++) {
+                graph.force.tick();
+            }
+            graph.preventCollisions = true;
         }
-        graph.preventCollisions = true;
         $('#graph-container').css('visibility', 'visible');
     });    
 }
@@ -684,8 +881,7 @@ function selectObject(obj, el) {
     highlightObject(obj);
 
     node.classed('selected', true);
-    $('#docs').html(obj.docs);
-    $('#docs-container').scrollTop(0);
+    showDocs(obj);
     resize(true);
 
     var $graph   = $('#graph-container'),
@@ -714,6 +910,71 @@ function selectObject(obj, el) {
     }
 }
 
+//Show the docs of obj in the side panel. They are rendered by docs.php
+//the first time the node is shown, and kept
+function showDocs(obj) {
+    graph.docsShown = obj;
+    if (obj.docs !== undefined) {
+        $('#docs').html(obj.docs);
+        $('#docs-container').scrollTop(0);
+        return;
+    }
+
+    //docs.php doesn't read the graph, so it is sent what it shows of it
+    var type = (config.types[obj.type] ? config.types[obj.type].short : obj.type),
+        url  = config.docsUrl + '&name=' + encodeURIComponent(obj.name)
+            + '&type=' + encodeURIComponent(type)
+            + '&group=' + encodeURIComponent(obj.group || '');
+
+    $('#docs').html('<div class="alert alert-info">Loading ' + $('<div>').text(obj.name).html() + '...</div>');
+    d3.text(url, function(error, html) {
+        if (error) {
+            html = '<div class="alert alert-warning">Unable to load the documentation of this object</div>';
+        } else {
+            html = obj.docs = fillDocs(obj, html);
+        }
+
+        //Another node may have been selected while this one loaded
+        if (graph.docsShown === obj) {
+            $('#docs').html(html);
+            $('#docs-container').scrollTop(0);
+        }
+    });
+}
+
+//Add what docs.php leaves to the browser: the links to the objects
+//this one depends on and is depended on by, and the "missing" class on
+//links to objects that aren't in the view
+function fillDocs(obj, html) {
+    var docs = $('<div>').html(html);
+
+    function dependsLinks(header, names) {
+        var line = $('<span>').append($('<b>').text(header), ' ');
+        if (!names.length) {
+            return line.append('None');
+        }
+        names.forEach(function(name) {
+            line.append($('<a>', {
+                href        : '#obj-' + name.replace(/[^a-z0-9]+/gi, '-'),
+                'class'     : 'select-object',
+                'data-name' : name,
+                text        : name
+            }), ', ');
+        });
+        return line;
+    }
+    docs.find('.depends').append(
+        dependsLinks('Depends on:', obj.depends), '<br />',
+        dependsLinks('Depended on by:', obj.dependedOnBy), '<br />');
+
+    docs.find('.select-object').each(function() {
+        if (!graph.data[$(this).attr('data-name')]) {
+            $(this).addClass('missing');
+        }
+    });
+    return docs.html();
+}
+
 function deselectObject(doResize) {
     if (doResize || typeof doResize == 'undefined') {
 	// Uncomment to close metadata box on deselect click
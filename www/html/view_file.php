@@ -0,0 +1,39 @@
+<?php
+//Send a file of a view to the browser. A file the pass precompressed
+//(-visualize-compress) is sent as it is, with its Content-Encoding, to
+//browsers that accept it, and decompressed here for the rest
+require_once 'common.php';
+
+$types = array(
+    'objects.bin'  => 'application/octet-stream',
+    'graph.json'   => 'application/json',
+    'objects.json' => 'application/json',
+    'config.json'  => 'application/json'
+);
+$file = isset($_GET['file']) ? $_GET['file'] : '';
+if (!isset($types[$file])) {
+    http_response_code(404);
+    exit;
+}
+$filename = view_folder() . "/$file";
+
+header('Content-Type: ' . $types[$file]);
+header('Vary: Accept-Encoding');
+$found = find_view_file($filename);
+if ($found !== false) {
+    list($path, $encoding) = $found;
+    if ($encoding != '') {
+        header("Content-Encoding: $encoding");
+    }
+    header('Content-Length: ' . filesize($path));
+    readfile($path);
+    exit;
+}
+
+$contents = read_view_file($filename);
+if ($contents === false) {
+    http_response_code(404);
+    exit;
+}
+echo $contents;
+?>